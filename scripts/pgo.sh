@@ -0,0 +1,25 @@
+#!/bin/sh
+# Profile guided build: builds an instrumented binary, trains it on the
+# perft bench positions and rebuilds with the collected profile.
+#
+# Usage: scripts/pgo.sh [bench depth]
+# The optimized binary ends up in build/pgo/graph.
+set -e
+
+cd "$(dirname "$0")/.."
+depth=${1:-3}
+profiles=build/pgo/pgo
+
+rm -rf "$profiles"
+cmake --preset pgo-generate
+cmake --build --preset pgo-generate
+build/pgo/graph bench "$depth"
+
+# Clang writes raw profiles which have to be merged first.
+if ls "$profiles"/*.profraw >/dev/null 2>&1; then
+    llvm-profdata merge -output="$profiles/default.profdata" "$profiles"/*.profraw
+fi
+
+cmake --preset pgo-use
+cmake --build --preset pgo-use
+build/pgo/graph bench "$depth"
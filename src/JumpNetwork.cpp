@@ -1,30 +1,24 @@
 #include "JumpNetwork.h"
 
+#include <algorithm>
+#include <memory>
 #include <stack>
+#include "chess/tables.h"
+#include "utils/hashcat.h"
+#include "utils/stats.h"
 
 namespace sjadam {
-    static const std::pair<int, int> all_directions[8] = {
-            {-1, -1},
-            {-1, 0},
-            {-1, 1},
-            {0,  -1},
-            {0,  1},
-            {1,  -1},
-            {1,  0},
-            {1,  1}};
-
     static inline std::list<lczero::BoardSquare> get_neighbours(const lczero::BoardSquare& source,
                                                                 const lczero::BitBoard& our_board,
                                                                 const lczero::BitBoard& complete_board) {
         std::list<lczero::BoardSquare> result;
-        for (const auto& d : all_directions) {
-            const int to_row = source.row() + 2 * d.first;
-            const int to_col = source.col() + 2 * d.second;
-            if (!lczero::BoardSquare::IsValid(to_row, to_col)) continue;
-            const int over_row = source.row() + d.first;
-            const int over_col = source.col() + d.second;
-            if (our_board.get(over_row, over_col)) {
-                const lczero::BoardSquare to_square(to_row, to_col);
+        if (!lczero::tables::kJumpOverMask[source.as_int()].intersects(our_board)) return result;
+        const auto& over = lczero::tables::kJumpOver[source.as_int()];
+        const auto& landing = lczero::tables::kJumpLanding[source.as_int()];
+        for (int d = 0; d < 8; ++d) {
+            if (landing[d] < 0) continue;
+            if (our_board.get(static_cast<std::uint8_t>(over[d]))) {
+                const lczero::BoardSquare to_square(static_cast<std::uint8_t>(landing[d]));
                 if (!complete_board.get(to_square)) {
                     result.push_back(to_square);
                 }
@@ -33,6 +27,126 @@ namespace sjadam {
         return result;
     }
 
+    namespace {
+        const std::uint64_t kNotFileA = ~0x0101010101010101ULL;
+        const std::uint64_t kNotFileH = ~0x8080808080808080ULL;
+
+        inline std::uint64_t shift(std::uint64_t squares, int row, int col) {
+            const int delta = row * 8 + col;
+            squares = delta > 0 ? squares << delta : squares >> -delta;
+            if (col > 0) squares &= kNotFileA;
+            if (col < 0) squares &= kNotFileH;
+            return squares;
+        }
+
+        inline std::uint64_t shift_raw(std::uint64_t squares, int delta) {
+            return delta > 0 ? squares << delta : squares >> -delta;
+        }
+
+        // Shift of a jump in each direction of kDirections.
+        const int kJumpDeltas[8] = {-18, -16, -14, -2, 2, 14, 16, 18};
+
+        // For every direction, the squares from which a jump over a piece on
+        // @over to an @empty square is possible. Masking with it first means
+        // the two step shift of a jump can't wrap around the board.
+        void find_can_jump(std::uint64_t over, std::uint64_t empty, std::uint64_t (&can_jump)[8]) {
+            for (int i = 0; i < 8; ++i) {
+                const int row = lczero::tables::kDirections[i][0];
+                const int col = lczero::tables::kDirections[i][1];
+                can_jump[i] = shift(over, -row, -col) & shift(shift(empty, -row, -col), -row, -col);
+            }
+        }
+
+        // Landing squares of all jumps from @squares.
+        inline std::uint64_t landings(const std::uint64_t (&can_jump)[8], std::uint64_t squares) {
+            std::uint64_t result = 0;
+            for (int i = 0; i < 8; ++i) result |= shift_raw(squares & can_jump[i], kJumpDeltas[i]);
+            return result;
+        }
+
+        // Squares from which a jump lands on one of @squares.
+        inline std::uint64_t origins(const std::uint64_t (&can_jump)[8], std::uint64_t squares) {
+            std::uint64_t result = 0;
+            for (int i = 0; i < 8; ++i) result |= can_jump[i] & shift_raw(squares, -kJumpDeltas[i]);
+            return result;
+        }
+
+        void find_components(std::uint64_t our, std::uint64_t their, Components* components) {
+            const std::uint64_t empty = ~(our | their);
+            std::uint64_t over_ours[8];
+            std::uint64_t over_theirs[8];
+            find_can_jump(our, empty, over_ours);
+            find_can_jump(their, empty, over_theirs);
+            components->size = 0;
+            std::uint64_t seeds = landings(over_ours, our);
+            while (seeds) {
+                std::uint64_t component = seeds & -seeds;
+                for (std::uint64_t added = component; added;) {
+                    added = landings(over_ours, added) & ~component;
+                    component |= added;
+                }
+                seeds &= ~component;
+                Component& result = components->items[components->size++];
+                result.sources = origins(over_ours, component) & our;
+                result.destinations = component | landings(over_theirs, component);
+            }
+        }
+
+        // Almost all positions have fewer components, the rest aren't cached.
+        const int kCachedComponents = 16;
+        const std::size_t kCacheEntries = 1 << 11;
+
+        struct CacheEntry {
+            std::uint64_t our = 0;
+            std::uint64_t their = 0;
+            int size = -1;
+            Component items[kCachedComponents];
+        };
+
+        thread_local std::unique_ptr<CacheEntry[]> cache;
+    }
+
+    void get_components(const lczero::BitBoard& our_board,
+                        const lczero::BitBoard& their_board,
+                        Components* components) {
+        SJADAM_STAGE_SCOPE(kStageJumpNetwork);
+        SJADAM_COUNT(kJumpNetworkCalls, 1);
+        const std::uint64_t our = our_board.as_int();
+        const std::uint64_t their = their_board.as_int();
+        if (!cache) cache.reset(new CacheEntry[kCacheEntries]);
+        CacheEntry& entry = cache[lczero::HashCat({our, their}) & (kCacheEntries - 1)];
+        if (entry.size >= 0 && entry.our == our && entry.their == their) {
+            SJADAM_COUNT(kJumpCacheHits, 1);
+            components->size = entry.size;
+            std::copy(entry.items, entry.items + entry.size, components->items.begin());
+            return;
+        }
+        SJADAM_COUNT(kJumpCacheMisses, 1);
+        find_components(our, their, components);
+        SJADAM_COUNT(kJumpComponents, components->size);
+        if (components->size <= kCachedComponents) {
+            entry.our = our;
+            entry.their = their;
+            entry.size = components->size;
+            std::copy(components->begin(), components->end(), entry.items);
+        }
+    }
+
+    JumpReach::JumpReach(const lczero::BitBoard& our_board, const lczero::BitBoard& their_board) {
+        const std::uint64_t empty = ~(our_board + their_board).as_int();
+        find_can_jump(our_board.as_int(), empty, over_ours_);
+        find_can_jump(their_board.as_int(), empty, over_theirs_);
+    }
+
+    lczero::BitBoard JumpReach::destinations(const lczero::BitBoard& sources) const {
+        std::uint64_t reached = landings(over_ours_, sources.as_int());
+        for (std::uint64_t added = reached; added;) {
+            added = landings(over_ours_, added) & ~reached;
+            reached |= added;
+        }
+        return reached | landings(over_theirs_, reached);
+    }
+
     /**
      * Get the set of all pairs of destination squares
      * with the corresponding set of source squares.
@@ -42,6 +156,8 @@ namespace sjadam {
     std::list<std::pair<std::list<lczero::BoardSquare>, std::list<lczero::BoardSquare>>>
     get_source_and_destination_squares(const lczero::BitBoard& our_board,
                                        const lczero::BitBoard& their_board) {
+        SJADAM_STAGE_SCOPE(kStageJumpNetwork);
+        SJADAM_COUNT(kJumpNetworkCalls, 1);
         std::array<int, 64> graphs{0};
         int graph_counter = 0;
         std::vector<std::list<lczero::BoardSquare>> sources;
@@ -92,6 +208,50 @@ namespace sjadam {
         for (int i = 0; i < graph_counter; ++i) {
             result.emplace_back(std::make_pair(sources[i], destinations[i]));
         }
+        SJADAM_COUNT(kJumpComponents, graph_counter);
+        return result;
+    }
+
+    JumpPaths::JumpPaths(const lczero::BoardSquare& source,
+                         const lczero::BitBoard& our_board,
+                         const lczero::BitBoard& their_board) : source_(source) {
+        parent_.fill(-1);
+        const lczero::BitBoard complete_board = our_board + their_board;
+        // Jumps over our pieces, breadth first. landings_ doubles as the queue.
+        for (const lczero::BoardSquare& square : get_neighbours(source, our_board, complete_board)) {
+            if (parent_[square.as_int()] >= 0) continue;
+            parent_[square.as_int()] = static_cast<std::int8_t>(source.as_int());
+            landings_.push_back(square);
+        }
+        for (size_t i = 0; i < landings_.size(); ++i) {
+            const lczero::BoardSquare current_square = landings_[i];
+            for (const lczero::BoardSquare& neighbour : get_neighbours(current_square, our_board, complete_board)) {
+                if (parent_[neighbour.as_int()] >= 0) continue;
+                parent_[neighbour.as_int()] = static_cast<std::int8_t>(current_square.as_int());
+                landings_.push_back(neighbour);
+            }
+        }
+        // Then at most one jump over their piece, which ends the sequence,
+        // as in get_source_and_destination_squares().
+        const size_t our_landings = landings_.size();
+        for (size_t i = 0; i < our_landings; ++i) {
+            const lczero::BoardSquare current_square = landings_[i];
+            for (const lczero::BoardSquare& neighbour : get_neighbours(current_square, their_board, complete_board)) {
+                if (parent_[neighbour.as_int()] >= 0) continue;
+                parent_[neighbour.as_int()] = static_cast<std::int8_t>(current_square.as_int());
+                landings_.push_back(neighbour);
+            }
+        }
+    }
+
+    std::vector<lczero::BoardSquare> JumpPaths::path(const lczero::BoardSquare& landing) const {
+        std::vector<lczero::BoardSquare> result;
+        if (!is_landing(landing)) return result;
+        for (lczero::BoardSquare square = landing; square != source_;
+             square = lczero::BoardSquare(static_cast<std::uint8_t>(parent_[square.as_int()]))) {
+            result.push_back(square);
+        }
+        std::reverse(result.begin(), result.end());
         return result;
     }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <vector>
 #include <list>
 #include "chess/bitboard.h"
@@ -15,4 +16,93 @@ namespace sjadam {
     std::list<std::pair<std::list<lczero::BoardSquare>, std::list<lczero::BoardSquare>>>
     get_source_and_destination_squares(const lczero::BitBoard& our_board,
                                        const lczero::BitBoard& their_board);
-}
\ No newline at end of file
+
+    /**
+     * A jump component in compact form: the pieces which can jump into it
+     * and every square they can finish their jumps on, including the squares
+     * reached by one last jump over an opponent piece.
+     */
+    struct Component {
+        lczero::BitBoard sources;
+        lczero::BitBoard destinations;
+    };
+
+    struct Components {
+        // Every component has at least one empty square of its own.
+        static constexpr int kMaxComponents = 64;
+
+        const Component* begin() const { return items.data(); }
+        const Component* end() const { return items.data() + size; }
+
+        int size = 0;
+        std::array<Component, kMaxComponents> items;
+    };
+
+    /**
+     * The same components as get_source_and_destination_squares(), found
+     * with bitboard flood fills. Results are kept in a small lossy cache per
+     * thread keyed by the two occupancies, which repeat all the time between
+     * sibling moves and through transpositions.
+     */
+    void get_components(const lczero::BitBoard& our_board,
+                        const lczero::BitBoard& their_board,
+                        Components* components);
+
+    /**
+     * Where groups of pieces can finish their jumps, like the destinations
+     * of their components but without telling the components apart. A few
+     * flood fills from the pieces of interest are much cheaper than all
+     * components when looking for attacks on a single square.
+     */
+    class JumpReach {
+    public:
+        JumpReach(const lczero::BitBoard& our_board,
+                  const lczero::BitBoard& their_board);
+
+        /**
+         * @return every square the pieces on @sources, which have to be
+         * ours, can finish a jump on.
+         */
+        lczero::BitBoard destinations(const lczero::BitBoard& sources) const;
+
+    private:
+        // For every direction of lczero::tables::kDirections, the squares
+        // from which a jump over our (their) pieces can land.
+        std::uint64_t over_ours_[8];
+        std::uint64_t over_theirs_[8];
+    };
+
+    /**
+     * Jump paths of a single piece. One breadth first search from the
+     * piece's square records the square every landing square was first
+     * reached from, so the shortest jump path to any landing square is read
+     * back in O(path length).
+     */
+    class JumpPaths {
+    public:
+        JumpPaths(const lczero::BoardSquare& source,
+                  const lczero::BitBoard& our_board,
+                  const lczero::BitBoard& their_board);
+
+        /**
+         * @return landing squares, closest first.
+         */
+        const std::vector<lczero::BoardSquare>& landings() const { return landings_; }
+
+        bool is_landing(const lczero::BoardSquare& square) const {
+            return parent_[square.as_int()] >= 0;
+        }
+
+        /**
+         * @return the landing squares of every jump from the source to
+         * @landing, @landing last; empty if it can't be reached.
+         */
+        std::vector<lczero::BoardSquare> path(const lczero::BoardSquare& landing) const;
+
+    private:
+        lczero::BoardSquare source_;
+        // Previous square on the path, -1 for squares which aren't landings.
+        std::array<std::int8_t, 64> parent_;
+        std::vector<lczero::BoardSquare> landings_;
+    };
+}
@@ -0,0 +1,212 @@
+#include "book/book.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+
+const char kMagic[4] = {'S', 'J', 'B', 'K'};
+const uint32_t kVersion = 1;
+
+struct BookHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+};
+
+const uint16_t kCastlingBit = 1 << 12;
+
+bool IsResult(const std::string& token) {
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// Checks the move given in coordinate notation, so that castlings get their
+// flag. Plain king moves come first, as in the move list.
+Move ParseMove(const ChessBoard& board, const std::string& str) {
+  const bool coordinates = (str.size() == 4 || str.size() == 5) && str[0] >= 'a' &&
+                           str[0] <= 'h' && str[1] >= '1' && str[1] <= '8' &&
+                           str[2] >= 'a' && str[2] <= 'h' && str[3] >= '1' && str[3] <= '8';
+  if (!coordinates) throw Exception("Bad book move: " + str);
+  Move move(str, board.flipped());
+  const bool check = board.IsUnderCheck();
+  for (int castling = 0; castling < 2; ++castling) {
+    if (castling) move.SetCastling();
+    if (board.IsPseudoLegal(move) && board.IsLegalMove(move, check)) return move;
+  }
+  throw Exception("Illegal book move: " + str);
+}
+
+}  // namespace
+
+Move BookEntry::GetMove() const {
+  Move result(BoardSquare(static_cast<uint8_t>((move >> 6) & 63)),
+              BoardSquare(static_cast<uint8_t>(move & 63)));
+  if (move & kCastlingBit) result.SetCastling();
+  return result;
+}
+
+void OpeningBookBuilder::AddGame(const std::string& game) {
+  std::istringstream stream(game);
+  std::vector<std::string> tokens;
+  std::string token;
+  while (stream >> token) tokens.push_back(token);
+  AddMoves(tokens);
+}
+
+void OpeningBookBuilder::AddMoves(const std::vector<std::string>& tokens) {
+  // Score of the side which made the first move.
+  int white_score = -1;
+  if (!tokens.empty()) {
+    const std::string& last = tokens.back();
+    if (last == "1-0") white_score = 2;
+    if (last == "0-1") white_score = 0;
+    if (last == "1/2-1/2") white_score = 1;
+  }
+
+  // Entries are only updated once every move is known to be legal.
+  std::vector<std::pair<uint64_t, Move>> moves;
+  ChessBoard board;
+  board.SetFromFen(ChessBoard::kStartingFen);
+  for (const std::string& token : tokens) {
+    if (IsResult(token) || static_cast<int>(moves.size()) >= max_ply_) break;
+    const Move move = ParseMove(board, token);
+    moves.emplace_back(board.Hash(), move);
+    board.ApplyMove(move);
+    board.Mirror();
+  }
+  for (size_t ply = 0; ply < moves.size(); ++ply) {
+    const Move move = moves[ply].second;
+    const uint16_t packed = move.as_packed_int() | (move.castling() ? kCastlingBit : 0);
+    BookEntry& entry = entries_[{moves[ply].first, packed}];
+    entry.key = moves[ply].first;
+    entry.move = packed;
+    int score = 1;
+    if (white_score >= 0) score = ply % 2 ? 2 - white_score : white_score;
+    entry.weight = static_cast<uint16_t>(std::min(0xFFFF, entry.weight + score));
+    ++entry.count;
+  }
+}
+
+void OpeningBookBuilder::AddMovesOfGame(const std::vector<std::string>& tokens) {
+  try {
+    AddMoves(tokens);
+  } catch (const Exception&) {
+    ++skipped_games_;
+  }
+}
+
+void OpeningBookBuilder::AddGames(std::istream& input) {
+  std::vector<std::string> tokens;
+  std::string line;
+  // Whether the input is PGN, otherwise every line is a game.
+  bool pgn = false;
+  bool in_comment = false;
+  // Nesting level of variations, which are skipped.
+  int variation = 0;
+  while (std::getline(input, line)) {
+    if (!in_comment && variation == 0 && !line.empty() && line[0] == '[') {
+      // Tag of the next game, the movetext of the previous one is complete.
+      pgn = true;
+      if (!tokens.empty()) AddMovesOfGame(tokens);
+      tokens.clear();
+      continue;
+    }
+    std::string token;
+    for (size_t i = 0; i <= line.size(); ++i) {
+      const char c = i < line.size() ? line[i] : ' ';
+      if (in_comment) {
+        in_comment = c != '}';
+        continue;
+      }
+      // A token ends at the bracket of a variation and belongs to the level
+      // before it.
+      const int level = variation;
+      if (c == '{') {
+        in_comment = true;
+      } else if (c == ';') {
+        // Comment till the end of line.
+        i = line.size();
+      } else if (c == '(') {
+        ++variation;
+      } else if (c == ')') {
+        variation = std::max(0, variation - 1);
+      } else if (!std::isspace(static_cast<unsigned char>(c))) {
+        token += c;
+        continue;
+      }
+      // Move numbers look like "12." or "12...".
+      const size_t dot = token.find_last_of('.');
+      if (dot != std::string::npos) token = token.substr(dot + 1);
+      // Annotations: "e2e4+", "e2e4!?" and NAGs like "$1".
+      if (!token.empty() && token[0] == '$') token.clear();
+      while (!token.empty() && std::strchr("+#!?", token.back())) token.pop_back();
+      if (!token.empty() && level == 0) tokens.push_back(token);
+      token.clear();
+    }
+    const bool game_over = !tokens.empty() && IsResult(tokens.back());
+    if (game_over || (!pgn && !in_comment && variation == 0)) {
+      if (!tokens.empty()) AddMovesOfGame(tokens);
+      tokens.clear();
+    }
+  }
+  if (!tokens.empty()) AddMovesOfGame(tokens);
+}
+
+void OpeningBookBuilder::Write(const std::string& filename) const {
+  BookHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.size = entries_.size();
+  std::FILE* file = std::fopen(filename.c_str(), "wb");
+  if (!file) throw Exception("Cannot write book: " + filename);
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  // std::map keeps entries sorted by (key, move).
+  for (const auto& entry : entries_) {
+    ok = ok && std::fwrite(&entry.second, sizeof(BookEntry), 1, file) == 1;
+  }
+  if (std::fclose(file) != 0 || !ok) throw Exception("Cannot write book: " + filename);
+}
+
+OpeningBook::OpeningBook(const std::string& filename) : file_(filename) {
+  BookHeader header;
+  if (file_.size() < sizeof(header)) throw Exception("Bad book file: " + filename);
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      file_.size() != sizeof(header) + header.size * sizeof(BookEntry)) {
+    throw Exception("Bad book file: " + filename);
+  }
+  entries_ = reinterpret_cast<const BookEntry*>(file_.data() + sizeof(header));
+  size_ = header.size;
+}
+
+std::pair<const BookEntry*, const BookEntry*> OpeningBook::Find(
+    const ChessBoard& board) const {
+  const uint64_t key = board.Hash();
+  return std::equal_range(
+      entries_, entries_ + size_, BookEntry{key, 0, 0, 0},
+      [](const BookEntry& a, const BookEntry& b) { return a.key < b.key; });
+}
+
+Move OpeningBook::Probe(const ChessBoard& board, uint64_t random) const {
+  const auto range = Find(board);
+  if (range.first == range.second) return Move();
+  uint64_t total = 0;
+  for (auto it = range.first; it != range.second; ++it) total += it->weight;
+  if (total == 0) return range.first->GetMove();
+  uint64_t pick = random % total;
+  for (auto it = range.first; it != range.second; ++it) {
+    if (pick < it->weight) return it->GetMove();
+    pick -= it->weight;
+  }
+  return Move();
+}
+
+}  // namespace lczero
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chess/board.h"
+#include "utils/mapped_file.h"
+
+namespace lczero {
+
+// One (position, move) pair of the book, 16 bytes.
+struct BookEntry {
+  // ChessBoard::Hash() of the position.
+  uint64_t key;
+  // Move::as_packed_int() from the point of view of the side to move, bit 12
+  // is set for castlings.
+  uint16_t move;
+  // Sum of scores of the games: 2 for a win of the side to move, 1 for a draw
+  // or unknown result.
+  uint16_t weight;
+  // Number of games which played the move.
+  uint32_t count;
+
+  Move GetMove() const;
+};
+
+static_assert(sizeof(BookEntry) == 16, "BookEntry must be packed");
+
+// Collects book moves from games.
+class OpeningBookBuilder {
+ public:
+  // Only the first @max_ply plies of every game are used.
+  explicit OpeningBookBuilder(int max_ply = 30) : max_ply_(max_ply) {}
+
+  // Adds a game given as moves in coordinate notation ("e2e4 e7e5 ..."),
+  // optionally followed by the result ("1-0", "0-1", "1/2-1/2").
+  // Throws Exception on illegal moves, without adding any move of the game.
+  void AddGame(const std::string& game);
+  // Adds games from a stream of PGN files or of one game per line. In PGN
+  // tags, comments, variations, move numbers and annotations are skipped,
+  // moves must be in coordinate notation. Games with other moves are left
+  // out and counted in skipped_games().
+  void AddGames(std::istream& input);
+
+  // Writes the book sorted by key and move.
+  void Write(const std::string& filename) const;
+  size_t size() const { return entries_.size(); }
+  int skipped_games() const { return skipped_games_; }
+
+ private:
+  void AddMoves(const std::vector<std::string>& tokens);
+  // AddMoves() which counts the game as skipped instead of throwing.
+  void AddMovesOfGame(const std::vector<std::string>& tokens);
+
+  const int max_ply_;
+  int skipped_games_ = 0;
+  std::map<std::pair<uint64_t, uint16_t>, BookEntry> entries_;
+};
+
+// Opening book file: a header followed by sorted BookEntries. The file is
+// mapped and probed by binary search without copying.
+class OpeningBook {
+ public:
+  explicit OpeningBook(const std::string& filename);
+
+  // Range of entries for @board.
+  std::pair<const BookEntry*, const BookEntry*> Find(const ChessBoard& board) const;
+  // Picks one of the book moves with probability proportional to its weight.
+  // @random is any 64-bit random number. Returns Move() if the position is
+  // not in the book.
+  Move Probe(const ChessBoard& board, uint64_t random) const;
+
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile file_;
+  const BookEntry* entries_;
+  size_t size_;
+};
+
+}  // namespace lczero
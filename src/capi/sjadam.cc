@@ -0,0 +1,195 @@
+#include "capi/sjadam.h"
+
+#include <cstring>
+#include <exception>
+#include <new>
+#include <type_traits>
+
+#include "chess/board.h"
+#include "chess/notation.h"
+#include "chess/perft.h"
+
+namespace {
+
+using lczero::BoardSquare;
+using lczero::ChessBoard;
+using lczero::Move;
+
+static_assert(sizeof(ChessBoard) <= sizeof(sjadam_position),
+              "SJADAM_POSITION_SIZE is too small");
+static_assert(alignof(ChessBoard) <= alignof(sjadam_position),
+              "sjadam_position is not aligned enough");
+static_assert(std::is_trivially_copyable<ChessBoard>::value &&
+                  std::is_trivially_destructible<ChessBoard>::value,
+              "Positions are copied with memcpy and never destroyed");
+
+ChessBoard* Board(sjadam_position* position) {
+  return std::launder(reinterpret_cast<ChessBoard*>(position->opaque));
+}
+
+const ChessBoard& Board(const sjadam_position* position) {
+  return *std::launder(reinterpret_cast<const ChessBoard*>(position->opaque));
+}
+
+// Converts between the board's point of view and absolute squares.
+uint16_t ToExternal(const ChessBoard& board, Move move) {
+  if (board.flipped()) move.Mirror();
+  return move.as_packed_int() | (move.castling() ? SJADAM_MOVE_CASTLING : 0);
+}
+
+Move ToInternal(const ChessBoard& board, uint16_t move) {
+  Move result(BoardSquare(static_cast<uint8_t>((move >> 6) & 63)),
+              BoardSquare(static_cast<uint8_t>(move & 63)));
+  if (move & SJADAM_MOVE_CASTLING) result.SetCastling();
+  if (board.flipped()) result.Mirror();
+  return result;
+}
+
+// Checks that @move is legal and gives it the right castling bit. Like in
+// the move list, plain king moves come before castlings to the same square.
+bool FindLegal(const ChessBoard& board, Move move, Move* result) {
+  const bool check = board.IsUnderCheck();
+  Move candidate(move.from(), move.to());
+  for (int castling = 0; castling < 2; ++castling) {
+    if (castling) candidate.SetCastling();
+    if (board.IsPseudoLegal(candidate) && board.IsLegalMove(candidate, check)) {
+      *result = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t WriteMoves(const ChessBoard& board, uint16_t* moves, size_t capacity) {
+  Move legal[ChessBoard::kMaxLegalMoves];
+  const size_t total = board.GenerateLegalMoves(legal, ChessBoard::kMaxLegalMoves);
+  const size_t count = total < capacity ? total : capacity;
+  for (size_t i = 0; i < count; ++i) moves[i] = ToExternal(board, legal[i]);
+  return total;
+}
+
+}  // namespace
+
+extern "C" {
+
+int sjadam_position_init(sjadam_position* position) {
+  return sjadam_position_from_fen(position,
+                                  ChessBoard::kStartingFen.c_str());
+}
+
+int sjadam_position_from_fen(sjadam_position* position, const char* fen) {
+  try {
+    ChessBoard board;
+    board.SetFromFen(fen);
+    new (position->opaque) ChessBoard(board);
+    return 0;
+  } catch (const std::exception&) {
+    return -1;
+  }
+}
+
+int sjadam_side_to_move(const sjadam_position* position) {
+  return Board(position).flipped() ? 1 : 0;
+}
+
+size_t sjadam_legal_moves(const sjadam_position* position, uint16_t* moves,
+                          size_t capacity) {
+  try {
+    return WriteMoves(Board(position), moves, capacity);
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+void sjadam_legal_moves_batch(const sjadam_position* positions, size_t count,
+                              uint16_t* moves, size_t stride,
+                              uint32_t* counts) {
+  for (size_t i = 0; i < count; ++i) {
+    counts[i] = static_cast<uint32_t>(
+        sjadam_legal_moves(positions + i, moves + i * stride, stride));
+  }
+}
+
+size_t sjadam_count_legal_moves(const sjadam_position* position) {
+  try {
+    return Board(position).CountLegalMoves();
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+int sjadam_apply_move(sjadam_position* position, uint16_t move) {
+  try {
+    ChessBoard* board = Board(position);
+    Move legal;
+    if (!FindLegal(*board, ToInternal(*board, move), &legal)) return -1;
+    board->ApplyMove(legal);
+    board->Mirror();
+    return 0;
+  } catch (const std::exception&) {
+    return -1;
+  }
+}
+
+int sjadam_parse_move(const sjadam_position* position, const char* text,
+                      uint16_t* move) {
+  try {
+    const ChessBoard& board = Board(position);
+    Move legal;
+    if (!FindLegal(board, Move(text, board.flipped()), &legal)) return -1;
+    *move = ToExternal(board, legal);
+    return 0;
+  } catch (const std::exception&) {
+    return -1;
+  }
+}
+
+size_t sjadam_move_to_string(const sjadam_position* position, uint16_t move,
+                             char* buffer, size_t size) {
+  const ChessBoard& board = Board(position);
+  const Move internal = ToInternal(board, move);
+  char text[6];
+  size_t length = 0;
+  for (BoardSquare square : {BoardSquare(static_cast<uint8_t>((move >> 6) & 63)),
+                             BoardSquare(static_cast<uint8_t>(move & 63))}) {
+    text[length++] = static_cast<char>('a' + square.col());
+    text[length++] = static_cast<char>('1' + square.row());
+  }
+  if (internal.to().row() == 7 && !board.our_king().get(internal.from())) {
+    text[length++] = 'q';
+  }
+  text[length] = '\0';
+  if (size > 0) {
+    const size_t copied = length < size ? length : size - 1;
+    std::memcpy(buffer, text, copied);
+    buffer[copied] = '\0';
+  }
+  return length;
+}
+
+size_t sjadam_move_to_jump_notation(const sjadam_position* position,
+                                    uint16_t move, char* buffer, size_t size) {
+  const ChessBoard& board = Board(position);
+  const std::string text =
+      lczero::MoveToJumpNotation(board, ToInternal(board, move));
+  if (size > 0) {
+    const size_t copied = text.size() < size ? text.size() : size - 1;
+    std::memcpy(buffer, text.data(), copied);
+    buffer[copied] = '\0';
+  }
+  return text.size();
+}
+
+uint64_t sjadam_hash(const sjadam_position* position) {
+  return Board(position).Hash();
+}
+
+uint64_t sjadam_perft(const sjadam_position* position, int depth) {
+  try {
+    return lczero::Perft(Board(position), depth);
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+}  // extern "C"
@@ -0,0 +1,94 @@
+/*
+ * C interface to the sjadam move generator.
+ *
+ * Positions live in caller-owned storage (stack, arrays, numpy buffers, ...)
+ * and results are written to caller-provided buffers; the library never
+ * returns memory which has to be freed. A position may be copied with
+ * memcpy. Move generation, counting, applying moves, hashing and perft don't
+ * allocate either; parsing FENs and writing jump notation do.
+ *
+ * Moves are 16 bit integers in absolute coordinates (square a1 = 0, b1 = 1,
+ * ..., h8 = 63, no matter which side is to move):
+ *   bits 0..5   destination square
+ *   bits 6..11  source square
+ *   bit 15      castling
+ * Promotions are implied: every non-king piece reaching the last rank becomes
+ * a queen.
+ *
+ * Functions returning int return 0 on success and a negative value on error.
+ */
+
+#ifndef SJADAM_CAPI_SJADAM_H_
+#define SJADAM_CAPI_SJADAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SJADAM_POSITION_SIZE 64
+/* Enough for every legal move list of a single position. */
+#define SJADAM_MAX_MOVES 1024
+#define SJADAM_MOVE_CASTLING 0x8000
+
+typedef struct sjadam_position {
+  uint64_t opaque[SJADAM_POSITION_SIZE / 8];
+} sjadam_position;
+
+/* Sets up the starting position. */
+int sjadam_position_init(sjadam_position* position);
+
+/* Sets up the position from a FEN string. Fails on anything but 8 ranks of
+ * 8 files with one king per side. */
+int sjadam_position_from_fen(sjadam_position* position, const char* fen);
+
+/* 0 when white is to move, 1 when black is to move. */
+int sjadam_side_to_move(const sjadam_position* position);
+
+/* Writes up to @capacity distinct legal moves to @moves and returns the
+ * total number of legal moves, which may be larger than @capacity. */
+size_t sjadam_legal_moves(const sjadam_position* position, uint16_t* moves,
+                          size_t capacity);
+
+/* Legal moves of @count positions. The moves of position i go to
+ * moves[i * stride], at most @stride of them, and counts[i] is set to the
+ * total number of legal moves of position i. */
+void sjadam_legal_moves_batch(const sjadam_position* positions, size_t count,
+                              uint16_t* moves, size_t stride,
+                              uint32_t* counts);
+
+/* Number of distinct legal moves, without listing them. */
+size_t sjadam_count_legal_moves(const sjadam_position* position);
+
+/* Plays @move, which has to be legal. The castling bit may be left out. */
+int sjadam_apply_move(sjadam_position* position, uint16_t move);
+
+/* Parses a move in coordinate notation ("e2e4", "e7e8q"). */
+int sjadam_parse_move(const sjadam_position* position, const char* text,
+                      uint16_t* move);
+
+/* Writes @move of @position in coordinate notation, NUL terminated, to
+ * @buffer of @size bytes (6 bytes always suffice). Returns the length
+ * without the terminator. */
+size_t sjadam_move_to_string(const sjadam_position* position, uint16_t move,
+                             char* buffer, size_t size);
+
+/* Like sjadam_move_to_string() but in SAN-like notation with every jump,
+ * e.g. "Nb1^b3^d5xe7" (see src/chess/notation.h). 256 bytes always
+ * suffice. */
+size_t sjadam_move_to_jump_notation(const sjadam_position* position,
+                                    uint16_t move, char* buffer, size_t size);
+
+/* 64 bit hash of the position. */
+uint64_t sjadam_hash(const sjadam_position* position);
+
+/* Number of leaf positions @depth plies deep. */
+uint64_t sjadam_perft(const sjadam_position* position, int depth);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // SJADAM_CAPI_SJADAM_H_
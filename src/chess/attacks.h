@@ -0,0 +1,16 @@
+#pragma once
+
+#include "chess/bitboard.h"
+
+namespace lczero {
+
+// Squares a rook (or bishop) on @square attacks: every square up to and
+// including the first @occupied one in each direction.
+//
+// Uses pext lookup tables when the CPU has BMI2, either because the build
+// assumes it or, in portable x86 builds, when detected at start up.
+// Otherwise the first blocker of each ray is found with a bit scan.
+BitBoard RookAttacks(BoardSquare square, BitBoard occupied);
+BitBoard BishopAttacks(BoardSquare square, BitBoard occupied);
+
+}  // namespace lczero
@@ -26,7 +26,10 @@
 */
 
 #include "bitboard.h"
+
+#include <algorithm>
 #include "../utils/exception.h"
+#include "../utils/stats.h"
 
 namespace lczero {
 
@@ -42,4 +45,17 @@ uint16_t Move::as_packed_int() const {
                                to().as_int());
 }
 
+uint16_t Move::as_nn_index() const {
+  return static_cast<uint16_t>(from().as_int() * 64 + to().as_int());
+}
+
+void RemoveDuplicateMoves(MoveList* moves) {
+  std::sort(moves->begin(), moves->end(), [](const Move& a, const Move& b) {
+    return a.as_packed_int() < b.as_packed_int();
+  });
+  const auto end = std::unique(moves->begin(), moves->end());
+  SJADAM_COUNT(kDuplicateMoves, moves->end() - end);
+  moves->erase(end, moves->end());
+}
+
 }  // namespace lczero
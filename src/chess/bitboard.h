@@ -65,6 +65,9 @@ namespace lczero {
         // Row := 7 - row.  Col remains the same.
         void Mirror() { square_ = static_cast<uint8_t>(square_ ^ 0b111000); }
 
+        // Col := 7 - col.  Row remains the same.
+        void FlipHorizontal() { square_ = static_cast<uint8_t>(square_ ^ 0b000111); }
+
         // Checks whether coordinate is within 0..7.
         static bool IsValidCoord(int x) { return x >= 0 && x < 8; }
 
@@ -101,7 +104,7 @@ namespace lczero {
 
         BitBoard(const BitBoard&) = default;
 
-        std::uint64_t as_int() const { return board_; }
+        constexpr std::uint64_t as_int() const { return board_; }
 
         void clear() { board_ = 0; }
 
@@ -190,6 +193,16 @@ namespace lczero {
                     (board_ & 0x00FF00FF00FF00FF) << 8 | (board_ & 0xFF00FF00FF00FF00) >> 8;
         }
 
+        // Flips files a and h (and so on) of a board.
+        void FlipHorizontal() {
+            board_ = (board_ & 0x5555555555555555) << 1 |
+                     (board_ & 0xAAAAAAAAAAAAAAAA) >> 1;
+            board_ = (board_ & 0x3333333333333333) << 2 |
+                     (board_ & 0xCCCCCCCCCCCCCCCC) >> 2;
+            board_ = (board_ & 0x0F0F0F0F0F0F0F0F) << 4 |
+                     (board_ & 0xF0F0F0F0F0F0F0F0) >> 4;
+        }
+
         bool operator==(const BitBoard& other) const {
             return board_ == other.board_;
         }
@@ -283,7 +296,9 @@ namespace lczero {
         // 0 .. 16384, knight promotion and no promotion is the same.
         uint16_t as_packed_int() const;
 
-        // 0 .. 1857, to use in neural networks.
+        // 0 .. 4095, to use in neural networks. After jumps a piece can end up
+        // on any square, so every (from, to) pair has its own index.
+        // Castling shares the index of the corresponding king move.
         uint16_t as_nn_index() const;
 
         // We ignore the castling bit, because UCI's `position moves ...` commands
@@ -299,6 +314,8 @@ namespace lczero {
 
         void Mirror() { data_ ^= 0b111000111000; }
 
+        void FlipHorizontal() { data_ ^= 0b000111000111; }
+
         std::string as_string() const {
             std::string res = from().as_string() + to().as_string();
             if (to().row() == 7) { // promotion
@@ -326,4 +343,8 @@ namespace lczero {
 
     using MoveList = std::vector<Move>;
 
+    // Sorts the list and removes moves which appear more than once (the
+    // generator emits a move once for every jump path leading to it).
+    void RemoveDuplicateMoves(MoveList* moves);
+
 }  // namespace lczero
@@ -27,12 +27,16 @@
 
 #include "chess/board.h"
 #include "JumpNetwork.h"
+#include "chess/attacks.h"
+#include "chess/tables.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include "utils/exception.h"
+#include "utils/stats.h"
 
 namespace lczero {
 
@@ -56,323 +60,180 @@ namespace lczero {
         their_king_.Mirror();
         std::swap(our_king_, their_king_);
         castlings_.Mirror();
+        // Our counts are the low half of the material key.
+        material_key_ = (material_key_ >> (4 * kMaterialTypes)) |
+                        ((material_key_ & kMaterialSideMask) << (4 * kMaterialTypes));
         flipped_ = !flipped_;
     }
 
+    void ChessBoard::FlipHorizontal() {
+        our_pieces_.FlipHorizontal();
+        their_pieces_.FlipHorizontal();
+        rooks_.FlipHorizontal();
+        bishops_.FlipHorizontal();
+        pawns_.FlipHorizontal();
+        our_king_.FlipHorizontal();
+        their_king_.FlipHorizontal();
+    }
+
+    uint64_t ChessBoard::CanonicalHash(bool* flip) const {
+        const uint64_t hash = Hash();
+        if (flip) *flip = false;
+        if (!castlings_.no_legal_castle()) return hash;
+        ChessBoard flipped(*this);
+        flipped.FlipHorizontal();
+        const uint64_t flipped_hash = flipped.Hash();
+        if (flipped_hash >= hash) return hash;
+        if (flip) *flip = true;
+        return flipped_hash;
+    }
+
     namespace {
         static const BitBoard kPawnMask = 0x00FFFFFFFFFFFF00ULL;
+        static const uint64_t kFileA = 0x0101010101010101ULL;
+        static const uint64_t kFileH = 0x8080808080808080ULL;
+        static const uint64_t kFileB = kFileA << 1;
+        static const uint64_t kFileG = kFileH >> 1;
+        static const uint64_t kRank1 = 0x00000000000000FFULL;
+        static const uint64_t kRank8 = 0xFF00000000000000ULL;
+
+        // kKingAttacks and kKnightAttacks for a whole set of squares at once,
+        // e.g. all landing squares of a jump component.
+        BitBoard KingAttacks(uint64_t squares) {
+            const uint64_t sideways = ((squares << 1) & ~kFileA) | ((squares >> 1) & ~kFileH);
+            const uint64_t row = squares | sideways;
+            return sideways | (row << 8) | (row >> 8);
+        }
+
+        BitBoard KnightAttacks(uint64_t squares) {
+            const uint64_t one = ((squares << 1) & ~kFileA) | ((squares >> 1) & ~kFileH);
+            const uint64_t two = ((squares << 2) & ~(kFileA | kFileB)) | ((squares >> 2) & ~(kFileG | kFileH));
+            return (one << 16) | (one >> 16) | (two << 8) | (two >> 8);
+        }
 
-        static const std::pair<int, int> kKingMoves[] = {
-                {-1, -1},
-                {-1, 0},
-                {-1, 1},
-                {0,  -1},
-                {0,  1},
-                {1,  -1},
-                {1,  0},
-                {1,  1}};
-
-        static const std::pair<int, int> kRookDirections[] = {
-                {1,  0},
-                {-1, 0},
-                {0,  1},
-                {0,  -1}};
-
-        static const std::pair<int, int> kBishopDirections[] = {
-                {1,  1},
-                {-1, 1},
-                {1,  -1},
-                {-1, -1}};
+        // Single pushes onto @empty squares and captures of @capturable squares
+        // (their pieces and en passant targets) by pawns on @squares. Pawns on
+        // the last rank don't move.
+        BitBoard PawnTargets(uint64_t squares, uint64_t empty, uint64_t capturable) {
+            squares &= ~kRank8;
+            const uint64_t captures = ((squares << 7) & ~kFileH) | ((squares << 9) & ~kFileA);
+            return ((squares << 8) & empty) | (captures & capturable);
+        }
+
+        // Squares two steps from @squares in any direction, with an @over square
+        // in between.
+        BitBoard JumpLandings(uint64_t squares, uint64_t over) {
+            uint64_t result = 0;
+            for (const auto& direction : tables::kDirections) {
+                const int delta = direction[0] * 8 + direction[1];
+                const uint64_t wrap = direction[1] > 0 ? kFileA : direction[1] < 0 ? kFileH : 0;
+                uint64_t step = (delta > 0 ? squares << delta : squares >> -delta) & ~wrap & over;
+                step = (delta > 0 ? step << delta : step >> -delta) & ~wrap;
+                result |= step;
+            }
+            return result;
+        }
+
+        // Squares their pawns on @squares attack. Their pawns on our first rank
+        // have reached their last one and don't move.
+        BitBoard TheirPawnAttacks(uint64_t squares) {
+            squares &= ~kRank1;
+            return ((squares >> 9) & ~kFileH) | ((squares >> 7) & ~kFileA);
+        }
+
+        using tables::kBetween;
+        using tables::kBishopRays;
+        using tables::kKingAttacks;
+        using tables::kKnightAttacks;
+        using tables::kPawnAttacks;
+        using tables::kRookRays;
 
 // If those squares are attacked, king cannot castle.
         static const int k00Attackers[] = {4, 5, 6};
         static const int k000Attackers[] = {2, 3, 4};
-
-// Which squares can rook attack from every of squares.
-        static const BitBoard kRookAttacks[] = {
-                0x01010101010101FEULL, 0x02020202020202FDULL, 0x04040404040404FBULL,
-                0x08080808080808F7ULL, 0x10101010101010EFULL, 0x20202020202020DFULL,
-                0x40404040404040BFULL, 0x808080808080807FULL, 0x010101010101FE01ULL,
-                0x020202020202FD02ULL, 0x040404040404FB04ULL, 0x080808080808F708ULL,
-                0x101010101010EF10ULL, 0x202020202020DF20ULL, 0x404040404040BF40ULL,
-                0x8080808080807F80ULL, 0x0101010101FE0101ULL, 0x0202020202FD0202ULL,
-                0x0404040404FB0404ULL, 0x0808080808F70808ULL, 0x1010101010EF1010ULL,
-                0x2020202020DF2020ULL, 0x4040404040BF4040ULL, 0x80808080807F8080ULL,
-                0x01010101FE010101ULL, 0x02020202FD020202ULL, 0x04040404FB040404ULL,
-                0x08080808F7080808ULL, 0x10101010EF101010ULL, 0x20202020DF202020ULL,
-                0x40404040BF404040ULL, 0x808080807F808080ULL, 0x010101FE01010101ULL,
-                0x020202FD02020202ULL, 0x040404FB04040404ULL, 0x080808F708080808ULL,
-                0x101010EF10101010ULL, 0x202020DF20202020ULL, 0x404040BF40404040ULL,
-                0x8080807F80808080ULL, 0x0101FE0101010101ULL, 0x0202FD0202020202ULL,
-                0x0404FB0404040404ULL, 0x0808F70808080808ULL, 0x1010EF1010101010ULL,
-                0x2020DF2020202020ULL, 0x4040BF4040404040ULL, 0x80807F8080808080ULL,
-                0x01FE010101010101ULL, 0x02FD020202020202ULL, 0x04FB040404040404ULL,
-                0x08F7080808080808ULL, 0x10EF101010101010ULL, 0x20DF202020202020ULL,
-                0x40BF404040404040ULL, 0x807F808080808080ULL, 0xFE01010101010101ULL,
-                0xFD02020202020202ULL, 0xFB04040404040404ULL, 0xF708080808080808ULL,
-                0xEF10101010101010ULL, 0xDF20202020202020ULL, 0xBF40404040404040ULL,
-                0x7F80808080808080ULL};
-// Which squares can bishop attack.
-        static const BitBoard kBishopAttacks[] = {
-                0x8040201008040200ULL, 0x0080402010080500ULL, 0x0000804020110A00ULL,
-                0x0000008041221400ULL, 0x0000000182442800ULL, 0x0000010204885000ULL,
-                0x000102040810A000ULL, 0x0102040810204000ULL, 0x4020100804020002ULL,
-                0x8040201008050005ULL, 0x00804020110A000AULL, 0x0000804122140014ULL,
-                0x0000018244280028ULL, 0x0001020488500050ULL, 0x0102040810A000A0ULL,
-                0x0204081020400040ULL, 0x2010080402000204ULL, 0x4020100805000508ULL,
-                0x804020110A000A11ULL, 0x0080412214001422ULL, 0x0001824428002844ULL,
-                0x0102048850005088ULL, 0x02040810A000A010ULL, 0x0408102040004020ULL,
-                0x1008040200020408ULL, 0x2010080500050810ULL, 0x4020110A000A1120ULL,
-                0x8041221400142241ULL, 0x0182442800284482ULL, 0x0204885000508804ULL,
-                0x040810A000A01008ULL, 0x0810204000402010ULL, 0x0804020002040810ULL,
-                0x1008050005081020ULL, 0x20110A000A112040ULL, 0x4122140014224180ULL,
-                0x8244280028448201ULL, 0x0488500050880402ULL, 0x0810A000A0100804ULL,
-                0x1020400040201008ULL, 0x0402000204081020ULL, 0x0805000508102040ULL,
-                0x110A000A11204080ULL, 0x2214001422418000ULL, 0x4428002844820100ULL,
-                0x8850005088040201ULL, 0x10A000A010080402ULL, 0x2040004020100804ULL,
-                0x0200020408102040ULL, 0x0500050810204080ULL, 0x0A000A1120408000ULL,
-                0x1400142241800000ULL, 0x2800284482010000ULL, 0x5000508804020100ULL,
-                0xA000A01008040201ULL, 0x4000402010080402ULL, 0x0002040810204080ULL,
-                0x0005081020408000ULL, 0x000A112040800000ULL, 0x0014224180000000ULL,
-                0x0028448201000000ULL, 0x0050880402010000ULL, 0x00A0100804020100ULL,
-                0x0040201008040201ULL};
-// Which squares can knight attack.
-        static const BitBoard kKnightAttacks[] = {
-                0x0000000000020400ULL, 0x0000000000050800ULL, 0x00000000000A1100ULL,
-                0x0000000000142200ULL, 0x0000000000284400ULL, 0x0000000000508800ULL,
-                0x0000000000A01000ULL, 0x0000000000402000ULL, 0x0000000002040004ULL,
-                0x0000000005080008ULL, 0x000000000A110011ULL, 0x0000000014220022ULL,
-                0x0000000028440044ULL, 0x0000000050880088ULL, 0x00000000A0100010ULL,
-                0x0000000040200020ULL, 0x0000000204000402ULL, 0x0000000508000805ULL,
-                0x0000000A1100110AULL, 0x0000001422002214ULL, 0x0000002844004428ULL,
-                0x0000005088008850ULL, 0x000000A0100010A0ULL, 0x0000004020002040ULL,
-                0x0000020400040200ULL, 0x0000050800080500ULL, 0x00000A1100110A00ULL,
-                0x0000142200221400ULL, 0x0000284400442800ULL, 0x0000508800885000ULL,
-                0x0000A0100010A000ULL, 0x0000402000204000ULL, 0x0002040004020000ULL,
-                0x0005080008050000ULL, 0x000A1100110A0000ULL, 0x0014220022140000ULL,
-                0x0028440044280000ULL, 0x0050880088500000ULL, 0x00A0100010A00000ULL,
-                0x0040200020400000ULL, 0x0204000402000000ULL, 0x0508000805000000ULL,
-                0x0A1100110A000000ULL, 0x1422002214000000ULL, 0x2844004428000000ULL,
-                0x5088008850000000ULL, 0xA0100010A0000000ULL, 0x4020002040000000ULL,
-                0x0400040200000000ULL, 0x0800080500000000ULL, 0x1100110A00000000ULL,
-                0x2200221400000000ULL, 0x4400442800000000ULL, 0x8800885000000000ULL,
-                0x100010A000000000ULL, 0x2000204000000000ULL, 0x0004020000000000ULL,
-                0x0008050000000000ULL, 0x00110A0000000000ULL, 0x0022140000000000ULL,
-                0x0044280000000000ULL, 0x0088500000000000ULL, 0x0010A00000000000ULL,
-                0x0020400000000000ULL};
-// Opponent pawn attacks
-        static const BitBoard kPawnAttacks[] = {
-                0x0000000000000200ULL, 0x0000000000000500ULL, 0x0000000000000A00ULL,
-                0x0000000000001400ULL, 0x0000000000002800ULL, 0x0000000000005000ULL,
-                0x000000000000A000ULL, 0x0000000000004000ULL, 0x0000000000020000ULL,
-                0x0000000000050000ULL, 0x00000000000A0000ULL, 0x0000000000140000ULL,
-                0x0000000000280000ULL, 0x0000000000500000ULL, 0x0000000000A00000ULL,
-                0x0000000000400000ULL, 0x0000000002000000ULL, 0x0000000005000000ULL,
-                0x000000000A000000ULL, 0x0000000014000000ULL, 0x0000000028000000ULL,
-                0x0000000050000000ULL, 0x00000000A0000000ULL, 0x0000000040000000ULL,
-                0x0000000200000000ULL, 0x0000000500000000ULL, 0x0000000A00000000ULL,
-                0x0000001400000000ULL, 0x0000002800000000ULL, 0x0000005000000000ULL,
-                0x000000A000000000ULL, 0x0000004000000000ULL, 0x0000020000000000ULL,
-                0x0000050000000000ULL, 0x00000A0000000000ULL, 0x0000140000000000ULL,
-                0x0000280000000000ULL, 0x0000500000000000ULL, 0x0000A00000000000ULL,
-                0x0000400000000000ULL, 0x0002000000000000ULL, 0x0005000000000000ULL,
-                0x000A000000000000ULL, 0x0014000000000000ULL, 0x0028000000000000ULL,
-                0x0050000000000000ULL, 0x00A0000000000000ULL, 0x0040000000000000ULL,
-                0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
-                0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
-                0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
-                0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
-                0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
-                0x0000000000000000ULL};
     }  // namespace
 
     BitBoard ChessBoard::pawns() const { return pawns_ * kPawnMask; }
 
+    BitBoard ChessBoard::en_passant() const { return pawns_ - kPawnMask; }
+
     MoveList ChessBoard::GeneratePseudolegalMoves() const {
+        SJADAM_COUNT(kPseudolegalCalls, 1);
         MoveList result;
-        auto source_and_destination_squares = sjadam::get_source_and_destination_squares(our_pieces_, their_pieces_);
-        for (auto pair : source_and_destination_squares) {
-            const std::list<BoardSquare>& sources = pair.first;
-            const std::list<BoardSquare>& destinations = pair.second;
-//            printf("Generating for pair: ");
-//            printf("{ ");
-//            for (auto sq : sources) {
-//                printf("%s ", sq.as_string().c_str());
-//            }
-//            printf("} -> { ");
-//            for (auto sq : destinations) {
-//                printf("%s ", sq.as_string().c_str());
-//            }
-//            printf("}\n");
-            BoardSquare king_square;
-            bool has_king_square = false;
-            std::list<BoardSquare> rook_squares;
-            std::list<BoardSquare> bishop_squares;
-            std::list<BoardSquare> pawn_squares;
-            std::list<BoardSquare> knight_squares;
-            for (BoardSquare source : sources) {
-                if (source == our_king_) {
-                    king_square = source;
-                    has_king_square = true;
-                } else if (pawns_.get(source)) {
-                    pawn_squares.emplace_back(source);
-                } else if (rooks_.get(source)) {
-                    rook_squares.emplace_back(source);
-                    if (bishops_.get(source)) {
-                        bishop_squares.emplace_back(source);
-                    }
-                } else if (bishops_.get(source)) {
-                    bishop_squares.emplace_back(source);
-                } else {
-                    knight_squares.emplace_back(source);
+        // King moves are checked against this instead of probing every target.
+        const BitBoard attacked = TheirAttacks();
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        const BitBoard our_pawns = pawns_ * kPawnMask;
+        sjadam::Components components;
+        sjadam::get_components(our_pieces_, their_pieces_, &components);
+        SJADAM_STAGE_BEGIN(kStageSjadamPass);
+        for (const auto& component : components) {
+            const BitBoard& sources = component.sources;
+            const BitBoard& landings = component.destinations;
+            const BitBoard pieces = sources - our_king_;
+            const BitBoard rook_squares = pieces * rooks_;
+            const BitBoard bishop_squares = pieces * bishops_;
+            const BitBoard pawn_squares = pieces * our_pawns;
+            const BitBoard knight_squares = pieces - rooks_ - bishops_ - our_pawns;
+            // Landing squares are shared by all sources of the component, so
+            // the targets of each piece type are collected once for all of them.
+            if (sources.get(our_king_)) {
+                for (const auto destination : KingAttacks(landings.as_int()) - our_pieces_ - attacked) {
+                    result.emplace_back(our_king_, destination);
                 }
             }
-            for (BoardSquare chess_move_source : destinations) {
-                if (has_king_square) {
-                    for (const auto& delta : kKingMoves) {
-                        const auto dst_row = chess_move_source.row() + delta.first;
-                        const auto dst_col = chess_move_source.col() + delta.second;
-                        if (!BoardSquare::IsValid(dst_row, dst_col)) continue;
-                        const BoardSquare destination(dst_row, dst_col);
-                        if (our_pieces_.get(destination)) continue;
-                        if (IsUnderAttack(destination)) continue;
-                        result.emplace_back(king_square, destination);
-                    }
-                }
-                if (!rook_squares.empty()) {
-                    for (const auto& direction : kRookDirections) {
-                        auto dst_row = chess_move_source.row();
-                        auto dst_col = chess_move_source.col();
-                        while (true) {
-                            dst_row += direction.first;
-                            dst_col += direction.second;
-                            if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                            const BoardSquare destination(dst_row, dst_col);
-                            if (our_pieces_.get(destination)) break;
-                            for (BoardSquare source : rook_squares) {
-                                result.emplace_back(source, destination);
-                            }
-                            if (their_pieces_.get(destination)) break;
-                        }
+            if (!rook_squares.empty()) {
+                BitBoard targets;
+                for (BoardSquare landing : landings) targets = targets + RookAttacks(landing, occupied);
+                for (const auto destination : targets - our_pieces_) {
+                    for (BoardSquare source : rook_squares) {
+                        result.emplace_back(source, destination);
                     }
                 }
-                if (!bishop_squares.empty()) {
-                    for (const auto& direction : kBishopDirections) {
-                        auto dst_row = chess_move_source.row();
-                        auto dst_col = chess_move_source.col();
-                        while (true) {
-                            dst_row += direction.first;
-                            dst_col += direction.second;
-                            if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                            const BoardSquare destination(dst_row, dst_col);
-                            if (our_pieces_.get(destination)) break;
-                            for (BoardSquare source : bishop_squares) {
-                                result.emplace_back(source, destination);
-                            }
-                            if (their_pieces_.get(destination)) break;
-                        }
+            }
+            if (!bishop_squares.empty()) {
+                BitBoard targets;
+                for (BoardSquare landing : landings) targets = targets + BishopAttacks(landing, occupied);
+                for (const auto destination : targets - our_pieces_) {
+                    for (BoardSquare source : bishop_squares) {
+                        result.emplace_back(source, destination);
                     }
                 }
-                if (!knight_squares.empty()) {
-                    for (const auto destination : kKnightAttacks[chess_move_source.as_int()]) {
-                        if (our_pieces_.get(destination)) continue;
-                        for (BoardSquare source : knight_squares) {
-                            result.emplace_back(source, destination);
-                        }
+            }
+            if (!knight_squares.empty()) {
+                for (const auto destination : KnightAttacks(landings.as_int()) - our_pieces_) {
+                    for (BoardSquare source : knight_squares) {
+                        result.emplace_back(source, destination);
                     }
                 }
-                if (!pawn_squares.empty()) {
-                    // Moves forward.
-                    {
-                        const auto dst_row = chess_move_source.row() + 1;
-                        const auto dst_col = chess_move_source.col();
-                        const BoardSquare destination(dst_row, dst_col);
-
-                        if (!our_pieces_.get(destination) && !their_pieces_.get(destination)) {
-                            for (BoardSquare source : pawn_squares) {
-                                result.emplace_back(source, destination);
-                            }
-                        }
-                    }
-                    // Captures.
-                    {
-                        for (auto direction : {-1, 1}) {
-                            const auto dst_row = chess_move_source.row() + 1;
-                            const auto dst_col = chess_move_source.col() + direction;
-                            if (dst_col < 0 || dst_col >= 8) continue;
-                            const BoardSquare destination(dst_row, dst_col);
-                            if (their_pieces_.get(destination)) {
-                                // Ordinary capture.
-                                for (BoardSquare source : pawn_squares) {
-                                    result.emplace_back(source, destination);
-                                }
-                            } else if (dst_row == 5 && pawns_.get(7, dst_col)) {
-                                // En passant.
-                                // "Pawn" on opponent's file 8 means that en passant is possible.
-                                // Those fake pawns are reset in ApplyMove.
-                                for (BoardSquare source : pawn_squares) {
-                                    result.emplace_back(source, destination);
-                                }
-                            }
-                        }
+            }
+            if (!pawn_squares.empty()) {
+                // En passant only by a plain capture from rank 5, see below.
+                for (const auto destination : PawnTargets(landings.as_int(), ~occupied.as_int(), their_pieces_.as_int())) {
+                    for (BoardSquare source : pawn_squares) {
+                        result.emplace_back(source, destination);
                     }
                 }
             }
         }
+        SJADAM_STAGE_END(kStageSjadamPass);
+        SJADAM_STAGE_BEGIN(kStagePlainPass);
         for (auto source : our_pieces_) {
             // King
             if (source == our_king_) {
-                for (const auto& delta : kKingMoves) {
-                    const auto dst_row = source.row() + delta.first;
-                    const auto dst_col = source.col() + delta.second;
-                    if (!BoardSquare::IsValid(dst_row, dst_col)) continue;
-                    const BoardSquare destination(dst_row, dst_col);
+                for (const auto destination : kKingAttacks[source.as_int()]) {
                     if (our_pieces_.get(destination)) continue;
-                    if (IsUnderAttack(destination)) continue;
+                    if (attacked.get(destination)) continue;
                     result.emplace_back(source, destination);
                 }
                 // Castlings.
-                if (castlings_.we_can_00()) {
-                    bool can_castle = true;
-                    for (int i = 5; i < 7; ++i) {
-                        if (our_pieces_.get(i) || their_pieces_.get(i)) {
-                            can_castle = false;
-                            break;
-                        }
-                    }
-                    if (can_castle) {
-                        for (auto x : k00Attackers) {
-                            if (IsUnderAttack(x)) {
-                                can_castle = false;
-                                break;
-                            }
-                        }
-                    }
-                    if (can_castle) {
-                        result.emplace_back(source, BoardSquare(0, 6));
-                        result.back().SetCastling();
-                    }
+                if (CanCastle(true, attacked)) {
+                    result.emplace_back(source, BoardSquare(0, 6));
+                    result.back().SetCastling();
                 }
-                if (castlings_.we_can_000()) {
-                    bool can_castle = true;
-                    for (int i = 1; i < 4; ++i) {
-                        if (our_pieces_.get(i) || their_pieces_.get(i)) {
-                            can_castle = false;
-                            break;
-                        }
-                    }
-                    if (can_castle) {
-                        for (auto x : k000Attackers) {
-                            if (IsUnderAttack(x)) {
-                                can_castle = false;
-                                break;
-                            }
-                        }
-                    }
-                    if (can_castle) {
-                        result.emplace_back(source, BoardSquare(0, 2));
-                        result.back().SetCastling();
-                    }
+                if (CanCastle(false, attacked)) {
+                    result.emplace_back(source, BoardSquare(0, 2));
+                    result.back().SetCastling();
                 }
                 continue;
             }
@@ -380,35 +241,15 @@ namespace lczero {
             // Rook (and queen)
             if (rooks_.get(source)) {
                 processed_piece = true;
-                for (const auto& direction : kRookDirections) {
-                    auto dst_row = source.row();
-                    auto dst_col = source.col();
-                    while (true) {
-                        dst_row += direction.first;
-                        dst_col += direction.second;
-                        if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                        const BoardSquare destination(dst_row, dst_col);
-                        if (our_pieces_.get(destination)) break;
-                        result.emplace_back(source, destination);
-                        if (their_pieces_.get(destination)) break;
-                    }
+                for (const auto destination : RookAttacks(source, occupied) - our_pieces_) {
+                    result.emplace_back(source, destination);
                 }
             }
             // Bishop (and queen)
             if (bishops_.get(source)) {
                 processed_piece = true;
-                for (const auto& direction : kBishopDirections) {
-                    auto dst_row = source.row();
-                    auto dst_col = source.col();
-                    while (true) {
-                        dst_row += direction.first;
-                        dst_col += direction.second;
-                        if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                        const BoardSquare destination(dst_row, dst_col);
-                        if (our_pieces_.get(destination)) break;
-                        result.emplace_back(source, destination);
-                        if (their_pieces_.get(destination)) break;
-                    }
+                for (const auto destination : BishopAttacks(source, occupied) - our_pieces_) {
+                    result.emplace_back(source, destination);
                 }
             }
             if (processed_piece) continue;
@@ -459,9 +300,46 @@ namespace lczero {
                 }
             }
         }
+        SJADAM_STAGE_END(kStagePlainPass);
+        SJADAM_COUNT(kMovesEmitted, result.size());
         return result;
     }
 
+    bool ChessBoard::CanCastle(bool kingside, const BitBoard& attacked) const {
+        if (kingside ? !castlings_.we_can_00() : !castlings_.we_can_000()) return false;
+        const int first = kingside ? 5 : 1;
+        const int last = kingside ? 7 : 4;
+        for (int i = first; i < last; ++i) {
+            if (our_pieces_.get(i) || their_pieces_.get(i)) return false;
+        }
+        const int* attackers = kingside ? k00Attackers : k000Attackers;
+        for (int i = 0; i < 3; ++i) {
+            if (attacked.get(attackers[i])) return false;
+        }
+        // @attacked only has plain attacks, jumps are checked one by one.
+        for (int i = 0; i < 3; ++i) {
+            if (IsUnderAttack(BoardSquare(static_cast<uint8_t>(attackers[i])))) return false;
+        }
+        return true;
+    }
+
+    ChessBoard::MaterialType ChessBoard::MaterialTypeAt(BoardSquare square) const {
+        if (rooks_.get(square)) return bishops_.get(square) ? kMaterialQueen : kMaterialRook;
+        if (bishops_.get(square)) return kMaterialBishop;
+        if ((pawns_ * kPawnMask).get(square)) return kMaterialPawn;
+        return kMaterialKnight;
+    }
+
+    void ChessBoard::ResetMaterialKey() {
+        material_key_ = 0;
+        for (BoardSquare square : our_pieces_ - our_king_) {
+            material_key_ += MaterialUnit(false, MaterialTypeAt(square));
+        }
+        for (BoardSquare square : their_pieces_ - their_king_) {
+            material_key_ += MaterialUnit(true, MaterialTypeAt(square));
+        }
+    }
+
     bool ChessBoard::ApplyMove(Move move) {
         const auto& from = move.from();
         const auto& to = move.to();
@@ -476,6 +354,9 @@ namespace lczero {
 
         // Remove captured piece
         bool reset_50_moves = their_pieces_.get(to);
+        if (reset_50_moves && to != their_king_) {
+            material_key_ -= MaterialUnit(true, MaterialTypeAt(to));
+        }
         their_pieces_.reset(to);
         rooks_.reset(to);
         bishops_.reset(to);
@@ -491,6 +372,7 @@ namespace lczero {
         if (from_row == 4 && pawns_.get(from) && from_col != to_col && pawns_.get(7, to_col)) {
             pawns_.reset(4, to_col);
             their_pieces_.reset(4, to_col);
+            material_key_ -= MaterialUnit(true, kMaterialPawn);
         }
 
         // Remove en passant flags.
@@ -504,19 +386,22 @@ namespace lczero {
             castlings_.reset_we_can_00();
             castlings_.reset_we_can_000();
             our_king_ = to;
-            // Castling
-            if (to_col - from_col > 1) {
-                // 0-0
-                our_pieces_.reset(7);
-                rooks_.reset(7);
-                our_pieces_.set(5);
-                rooks_.set(5);
-            } else if (from_col - to_col > 1) {
-                // 0-0-0
-                our_pieces_.reset(0);
-                rooks_.reset(0);
-                our_pieces_.set(3);
-                rooks_.set(3);
+            // Castling. Kings jump across files in sjadam, so only moves
+            // flagged by the generator are castlings.
+            if (move.castling()) {
+                if (to_col > from_col) {
+                    // 0-0
+                    our_pieces_.reset(7);
+                    rooks_.reset(7);
+                    our_pieces_.set(5);
+                    rooks_.set(5);
+                } else {
+                    // 0-0-0
+                    our_pieces_.reset(0);
+                    rooks_.reset(0);
+                    our_pieces_.set(3);
+                    rooks_.set(3);
+                }
             }
             return reset_50_moves;
         }
@@ -534,6 +419,10 @@ namespace lczero {
 
         // Promotion
         if (to.row() == 7) {
+            material_key_ += MaterialUnit(false, kMaterialQueen) - MaterialUnit(false, MaterialTypeAt(from));
+            rooks_.reset(from);
+            bishops_.reset(from);
+            pawns_.reset(from);
             rooks_.set(to);
             bishops_.set(to);
             return true;
@@ -557,53 +446,53 @@ namespace lczero {
         return reset_50_moves;
     }
 
-    bool ChessBoard::IsUnderAttack(BoardSquare square) const {
-        const int row = square.row();
-        const int col = square.col();
-        // Check king
-        {
-            const int krow = their_king_.row();
-            const int kcol = their_king_.col();
-            if (std::abs(krow - row) <= 1 && std::abs(kcol - col) <= 1) return true;
+    BitBoard ChessBoard::TheirAttacks() const {
+        // Our king is left out, so squares behind it on a slider's line count as
+        // attacked too.
+        const BitBoard occupied = our_pieces_ + their_pieces_ - our_king_;
+        BitBoard result = kKingAttacks[their_king_.as_int()];
+        result.set(their_king_);
+        const uint64_t pawns = (their_pieces_ * pawns_ * kPawnMask).as_int();
+        result = result + BitBoard(((pawns >> 9) & ~kFileH) | ((pawns >> 7) & ~kFileA));
+        result = result + KnightAttacks((their_pieces_ - their_king_ - rooks_ - bishops_ - (pawns_ * kPawnMask)).as_int());
+        for (BoardSquare rook : their_pieces_ * rooks_) {
+            result = result + RookAttacks(rook, occupied);
         }
+        for (BoardSquare bishop : their_pieces_ * bishops_) {
+            result = result + BishopAttacks(bishop, occupied);
+        }
+        return result;
+    }
+
+    ChessBoard::JumpThreats ChessBoard::TheirJumpThreats() const {
+        JumpThreats result;
+        const sjadam::JumpReach jumps(their_pieces_, our_pieces_);
+        const BitBoard reach = their_pieces_ + jumps.destinations(their_pieces_);
+        const BitBoard their_rooks = their_pieces_ * rooks_ - their_king_;
+        const BitBoard their_bishops = their_pieces_ * bishops_ - their_king_;
+        result.rook_pinners = their_rooks + jumps.destinations(their_rooks);
+        result.bishop_pinners = their_bishops + jumps.destinations(their_bishops);
+        result.jump_targets = JumpLandings(reach.as_int(), (our_pieces_ + their_pieces_).as_int());
+        result.landing_area = (reach - their_pieces_) + KingAttacks((reach - their_pieces_).as_int());
+        return result;
+    }
+
+    bool ChessBoard::IsUnderAttack(BoardSquare square) const {
+        SJADAM_STAGE_SCOPE(kStageIsUnderAttack);
+        SJADAM_COUNT(kAttackProbes, 1);
+        // Check king (their king's own square also counts as attacked).
+        if (square == their_king_ || kKingAttacks[square.as_int()].get(their_king_)) return true;
+        const BitBoard occupied = our_pieces_ + their_pieces_;
         // Check Rooks (and queen)
-        if (kRookAttacks[square.as_int()].intersects(their_pieces_ * rooks_)) {
-            for (const auto& direction : kRookDirections) {
-                auto dst_row = row;
-                auto dst_col = col;
-                while (true) {
-                    dst_row += direction.first;
-                    dst_col += direction.second;
-                    if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                    const BoardSquare destination(dst_row, dst_col);
-                    if (our_pieces_.get(destination)) break;
-                    if (their_pieces_.get(destination)) {
-                        if (rooks_.get(destination)) return true;
-                        break;
-                    }
-                }
-            }
+        for (BoardSquare attacker : kRookRays[square.as_int()] * their_pieces_ * rooks_) {
+            if (!kBetween[square.as_int()][attacker.as_int()].intersects(occupied)) return true;
         }
         // Check Bishops
-        if (kBishopAttacks[square.as_int()].intersects(their_pieces_ * bishops_)) {
-            for (const auto& direction : kBishopDirections) {
-                auto dst_row = row;
-                auto dst_col = col;
-                while (true) {
-                    dst_row += direction.first;
-                    dst_col += direction.second;
-                    if (!BoardSquare::IsValid(dst_row, dst_col)) break;
-                    const BoardSquare destination(dst_row, dst_col);
-                    if (our_pieces_.get(destination)) break;
-                    if (their_pieces_.get(destination)) {
-                        if (bishops_.get(destination)) return true;
-                        break;
-                    }
-                }
-            }
+        for (BoardSquare attacker : kBishopRays[square.as_int()] * their_pieces_ * bishops_) {
+            if (!kBetween[square.as_int()][attacker.as_int()].intersects(occupied)) return true;
         }
-        // Check pawns
-        if (kPawnAttacks[square.as_int()].intersects(their_pieces_ * pawns_)) {
+        // Check pawns (not the en passant flags on rank 8)
+        if (kPawnAttacks[square.as_int()].intersects(their_pieces_ * pawns_ * kPawnMask)) {
             return true;
         }
         // Check knights
@@ -614,10 +503,58 @@ namespace lczero {
                 return true;
             }
         }
-        return false;
+        // Then the same after jumping: a piece attacks the square if it can
+        // land on a square the same kind of piece would attack from. Only
+        // empty squares are landings.
+        const BitBoard rook_targets = RookAttacks(square, occupied);
+        const BitBoard bishop_targets = BishopAttacks(square, occupied);
+        const BitBoard targets = (kKingAttacks[square.as_int()] + kPawnAttacks[square.as_int()] +
+                                  kKnightAttacks[square.as_int()] + rook_targets + bishop_targets) - occupied;
+        if (targets.empty()) return false;
+        const sjadam::JumpReach reach(their_pieces_, our_pieces_);
+        // Most of the time no piece at all gets close.
+        if (!reach.destinations(their_pieces_).intersects(targets)) return false;
+        const BitBoard their_pawns = their_pieces_ * pawns_ * kPawnMask;
+        const BitBoard their_knights = their_pieces_ - their_king_ - rooks_ - bishops_ - their_pawns;
+        const BitBoard their_rooks = their_pieces_ * rooks_ - their_king_;
+        const BitBoard their_bishops = their_pieces_ * bishops_ - their_king_;
+        BitBoard king;
+        king.set(their_king_);
+        const auto reaches = [&reach](const BitBoard& pieces, const BitBoard& squares) {
+            return !pieces.empty() && !squares.empty() && reach.destinations(pieces).intersects(squares);
+        };
+        return reaches(their_rooks, rook_targets * targets) ||
+               reaches(their_bishops, bishop_targets * targets) ||
+               reaches(their_knights, kKnightAttacks[square.as_int()] * targets) ||
+               reaches(their_pawns, kPawnAttacks[square.as_int()] * targets) ||
+               reaches(king, kKingAttacks[square.as_int()] * targets);
+    }
+
+    BitBoard ChessBoard::PinMask(BoardSquare from, const JumpThreats& threats) const {
+        const BitBoard line = tables::kLine[our_king_.as_int()][from.as_int()];
+        if (line.empty()) return ~0ULL;
+        const bool orthogonal = from.row() == our_king_.row() || from.col() == our_king_.col();
+        const BitBoard occupied = our_pieces_ + their_pieces_ - from;
+        // Several sliders may pin @from when some of them jump first, the
+        // piece has to stay between our king and the closest one.
+        BitBoard result = ~0ULL;
+        for (BoardSquare pinner : line * (orthogonal ? threats.rook_pinners : threats.bishop_pinners)) {
+            const BitBoard between = kBetween[our_king_.as_int()][pinner.as_int()];
+            if (!between.get(from) || between.intersects(occupied)) continue;
+            BitBoard pin = between;
+            pin.set(pinner);
+            result = result * pin;
+        }
+        return result;
     }
 
     bool ChessBoard::IsLegalMove(Move move, bool was_under_check) const {
+        return IsLegalMove(move, was_under_check, was_under_check ? JumpThreats() : TheirJumpThreats());
+    }
+
+    bool ChessBoard::IsLegalMove(Move move, bool was_under_check, const JumpThreats& threats) const {
+        SJADAM_STAGE_SCOPE(kStageIsLegalMove);
+        SJADAM_COUNT(kLegalityChecks, 1);
         const auto& from = move.from();
         const auto& to = move.to();
 
@@ -638,65 +575,526 @@ namespace lczero {
             return !board.IsUnderCheck();
         }
 
-        // If it's kings move, check that destination
-        // is not under attack.
-        if (from == our_king_) {
-            // Castlings were checked earlier.
-            if (std::abs(static_cast<int>(from.col()) - static_cast<int>(to.col())) > 1)
-                return true;
-            return !IsUnderAttack(to);
-        }
-
-        // Not check that piece was pinned. And it was, check that after the move
-        // it is still on like of attack.
-        int dx = from.col() - our_king_.col();
-        int dy = from.row() - our_king_.row();
-
-        // If it's not on the same file/rank/diagonal as our king, cannot be pinned.
-        if (dx != 0 && dy != 0 && std::abs(dx) != std::abs(dy)) return true;
-        dx = (dx > 0) - (dx < 0);  // Sign.
-        dy = (dy > 0) - (dy < 0);
-        auto col = our_king_.col();
-        auto row = our_king_.row();
-        while (true) {
-            col += dx;
-            row += dy;
-            // Attacking line left board, good.
-            if (!BoardSquare::IsValid(row, col)) return true;
-            const BoardSquare square(row, col);
-            // The source square of the move is now free.
-            if (square == from) continue;
-            // The destination square if the move is our piece. King is not under
-            // attack.
-            if (square == to) return true;
-            // Our piece on the line. Not under attack.
-            if (our_pieces_.get(square)) return true;
-            if (their_pieces_.get(square)) {
-                if (dx == 0 || dy == 0) {
-                    // Have to be afraid of rook-like piece.
-                    return !rooks_.get(square);
-                } else {
-                    // Have to be afraid of bishop-like piece.
-                    return !bishops_.get(square);
-                }
-                return true;
-            }
+        // King moves change where their jumps go, other moves may (see
+        // JumpThreats). Pieces off their pin line may be safe when the pinner
+        // can't jump to its square any more. Just apply those.
+        if (from == our_king_ || threats.jump_targets.get(from) || threats.landing_area.get(to) ||
+            !PinMask(from, threats).get(to)) {
+            ChessBoard board(*this);
+            board.ApplyMove(move);
+            return !board.IsUnderCheck();
         }
+        return true;
     }
 
     MoveList ChessBoard::GenerateLegalMoves() const {
         const bool was_under_check = IsUnderCheck();
+        const JumpThreats threats = was_under_check ? JumpThreats() : TheirJumpThreats();
         MoveList move_list = GeneratePseudolegalMoves();
         MoveList result;
         result.reserve(move_list.size());
 
         for (Move m : move_list) {
-            if (IsLegalMove(m, was_under_check)) result.emplace_back(m);
+            if (IsLegalMove(m, was_under_check, threats)) result.emplace_back(m);
+        }
+
+        return result;
+    }
+
+    void ChessBoard::AddJumpTargets(BitBoard targets[64], const BitBoard& attacked, const BitBoard& within,
+                                    const BitBoard& king_within) const {
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        const BitBoard empty = ~occupied.as_int();
+        const BitBoard our_pawns = pawns_ * kPawnMask;
+        sjadam::Components components;
+        sjadam::get_components(our_pieces_, their_pieces_, &components);
+        for (const auto& component : components) {
+            const BitBoard& sources = component.sources;
+            const BitBoard& landings = component.destinations;
+            const bool has_king = sources.get(our_king_);
+            const bool has_rooks = sources.intersects(rooks_);
+            const bool has_bishops = sources.intersects(bishops_);
+            const bool has_pawns = sources.intersects(our_pawns);
+            const bool has_knights = !(sources - our_king_ - rooks_ - bishops_ - our_pawns).empty();
+            BitBoard king, rook, bishop, knight, pawn;
+            if (has_king) king = (KingAttacks(landings.as_int()) - our_pieces_) * king_within;
+            // Sliders look from the wanted squares for a landing square
+            // instead when there are fewer of them.
+            const BitBoard wanted = within - our_pieces_;
+            const bool from_wanted = wanted.count() < landings.count();
+            if (has_rooks) {
+                if (from_wanted) {
+                    for (BoardSquare target : wanted) {
+                        if (RookAttacks(target, occupied).intersects(landings)) rook.set(target);
+                    }
+                } else {
+                    for (BoardSquare landing : landings) rook = rook + RookAttacks(landing, occupied);
+                    rook = rook * wanted;
+                }
+            }
+            if (has_bishops) {
+                if (from_wanted) {
+                    for (BoardSquare target : wanted) {
+                        if (BishopAttacks(target, occupied).intersects(landings)) bishop.set(target);
+                    }
+                } else {
+                    for (BoardSquare landing : landings) bishop = bishop + BishopAttacks(landing, occupied);
+                    bishop = bishop * wanted;
+                }
+            }
+            if (has_knights) knight = KnightAttacks(landings.as_int()) * wanted;
+            // No en passant after jumping.
+            if (has_pawns) pawn = PawnTargets(landings.as_int(), empty.as_int(), their_pieces_.as_int()) * within;
+            for (BoardSquare source : sources) {
+                BitBoard& result = targets[source.as_int()];
+                if (source == our_king_) {
+                    result = result + (king - attacked);
+                } else if (our_pawns.get(source)) {
+                    result = result + pawn;
+                } else if (rooks_.get(source) || bishops_.get(source)) {
+                    if (rooks_.get(source)) result = result + rook;
+                    if (bishops_.get(source)) result = result + bishop;
+                } else {
+                    result = result + knight;
+                }
+            }
+        }
+    }
+
+    BitBoard ChessBoard::PlainTargets(BoardSquare source, const BitBoard& attacked) const {
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        if (source == our_king_) return kKingAttacks[source.as_int()] - our_pieces_ - attacked;
+        BitBoard result;
+        if (rooks_.get(source) || bishops_.get(source)) {
+            if (rooks_.get(source)) result = result + (RookAttacks(source, occupied) - our_pieces_);
+            if (bishops_.get(source)) result = result + (BishopAttacks(source, occupied) - our_pieces_);
+        } else if ((pawns_ * kPawnMask).get(source)) {
+            const uint64_t empty = ~occupied.as_int();
+            // En passant squares are on rank 6, only pawns on rank 5 get there.
+            const uint64_t capturable = their_pieces_.as_int() | ((pawns_.as_int() & kRank8) >> 16);
+            result = PawnTargets(1ull << source.as_int(), empty, capturable);
+            if (source.row() == 1 && !occupied.get(2, source.col()) && !occupied.get(3, source.col())) {
+                result.set(3, source.col());
+            }
+        } else {
+            result = kKnightAttacks[source.as_int()] - our_pieces_;
+        }
+        return result;
+    }
+
+    bool ChessBoard::NeedsApplying(BoardSquare source, bool was_under_check, const JumpThreats& threats) const {
+        // En passant captures remove a second piece from the board.
+        const bool en_passant_possible = !(pawns_ - kPawnMask).empty();
+        return was_under_check || source == our_king_ || threats.jump_targets.get(source) ||
+               (en_passant_possible && source.row() == 4 && pawns_.get(source));
+    }
+
+    void ChessBoard::CollectTargets(BitBoard targets[64], const BitBoard& attacked, const BitBoard& within,
+                                    const BitBoard& king_within) const {
+        AddJumpTargets(targets, attacked, within, king_within);
+        for (BoardSquare source : our_pieces_) {
+            targets[source.as_int()] = targets[source.as_int()] +
+                                       PlainTargets(source, attacked) * (source == our_king_ ? king_within : within);
+        }
+    }
+
+    void ChessBoard::AddLegalMoves(const BitBoard targets[64], MoveList* moves) const {
+        const bool was_under_check = IsUnderCheck();
+        const JumpThreats threats = was_under_check ? JumpThreats() : TheirJumpThreats();
+        for (BoardSquare source : our_pieces_) {
+            const BitBoard& result = targets[source.as_int()];
+            if (result.empty()) continue;
+            BitBoard safe;
+            if (!NeedsApplying(source, was_under_check, threats)) {
+                safe = (result - threats.landing_area) * PinMask(source, threats);
+            }
+            for (BoardSquare destination : result) {
+                const Move move(source, destination);
+                if (safe.get(destination) || IsLegalMove(move, was_under_check, threats)) moves->push_back(move);
+            }
         }
+    }
+
+    MoveList ChessBoard::GenerateCaptures() const {
+        const BitBoard en_passant = (pawns_.as_int() & kRank8) >> 16;
+        BitBoard targets[64];
+        CollectTargets(targets, TheirAttacks(), their_pieces_ + en_passant, their_pieces_ + en_passant);
+        // Only pawns capture en passant.
+        const BitBoard our_pawns = pawns_ * kPawnMask;
+        for (BoardSquare source : our_pieces_ - our_pawns) {
+            targets[source.as_int()] = targets[source.as_int()] * their_pieces_;
+        }
+        MoveList result;
+        AddLegalMoves(targets, &result);
+        return result;
+    }
 
+    MoveList ChessBoard::GeneratePromotions() const {
+        BitBoard targets[64];
+        // Kings don't promote.
+        CollectTargets(targets, BitBoard(), kRank8 & ~(our_pieces_ + their_pieces_).as_int(), BitBoard());
+        MoveList result;
+        AddLegalMoves(targets, &result);
         return result;
     }
 
+    MoveList ChessBoard::GenerateChecks() const {
+        const int king = their_king_.as_int();
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        const BitBoard en_passant = (pawns_.as_int() & kRank8) >> 16;
+        const BitBoard our_pawns = pawns_ * kPawnMask;
+        const BitBoard pawn_checks = TheirPawnAttacks(1ull << king);
+        const BitBoard quiet = ~(occupied.as_int() | kRank8);
+        BitBoard targets[64];
+        // Kings can't give check.
+        CollectTargets(targets, TheirAttacks(),
+                       (kKnightAttacks[king] + pawn_checks + kRookRays[king] + kBishopRays[king]) * quiet, BitBoard());
+        for (BoardSquare source : our_pieces_ - our_king_) {
+            // The moved piece has to attack their king from its destination,
+            // with its own square empty.
+            BitBoard checks;
+            if (our_pawns.get(source)) {
+                // Pawns only reach the en passant square by capturing.
+                checks = pawn_checks - en_passant;
+            } else if (rooks_.get(source) || bishops_.get(source)) {
+                if (rooks_.get(source)) checks = checks + RookAttacks(their_king_, occupied - source);
+                if (bishops_.get(source)) checks = checks + BishopAttacks(their_king_, occupied - source);
+            } else {
+                checks = kKnightAttacks[king];
+            }
+            targets[source.as_int()] = targets[source.as_int()] * checks;
+        }
+        MoveList result;
+        AddLegalMoves(targets, &result);
+        return result;
+    }
+
+    MoveList ChessBoard::GenerateEvasions() const {
+        const int king = our_king_.as_int();
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        const BitBoard en_passant = (pawns_.as_int() & kRank8) >> 16;
+        // Their pieces which attack our king without jumping. Whatever we do
+        // with pieces other than the king, each of them still does unless it
+        // is captured or blocked.
+        const BitBoard their_pawns = their_pieces_ * pawns_ * kPawnMask;
+        const BitBoard checkers = (RookAttacks(our_king_, occupied) * rooks_ +
+                                   BishopAttacks(our_king_, occupied) * bishops_) *
+                                          their_pieces_ +
+                                  kPawnAttacks[king] * their_pawns + kKnightAttacks[king] * their_knights();
+        BitBoard within = ~0ULL;
+        if (checkers.count() > 1) {
+            within = BitBoard();
+        } else if (!checkers.empty()) {
+            // A pawn which just moved two squares is also captured en passant.
+            within = checkers + kBetween[king][(*checkers.begin()).as_int()] + en_passant;
+        }
+        // Castling is never legal under check.
+        BitBoard targets[64];
+        CollectTargets(targets, TheirAttacks(), within, ~0ULL);
+        MoveList result;
+        AddLegalMoves(targets, &result);
+        return result;
+    }
+
+    int ChessBoard::CountLegalMoves() const { return GenerateLegalMoves(nullptr, 0); }
+
+    int ChessBoard::GenerateLegalMoves(Move* moves, int capacity) const {
+        const bool was_under_check = IsUnderCheck();
+        const BitBoard attacked = TheirAttacks();
+
+        // Union of targets per source square, so every move is counted once
+        // no matter how many jump paths lead to it.
+        BitBoard targets[64];
+        CollectTargets(targets, attacked, ~0ULL, ~0ULL);
+        BitBoard castlings;
+        castlings.set_if(BoardSquare(0, 6), CanCastle(true, attacked));
+        castlings.set_if(BoardSquare(0, 2), CanCastle(false, attacked));
+
+        int count = 0;
+        auto add = [&](Move move) {
+            if (count < capacity) moves[count] = move;
+            ++count;
+        };
+        const JumpThreats threats = was_under_check ? JumpThreats() : TheirJumpThreats();
+        for (BoardSquare source : our_pieces_) {
+            const BitBoard& result = targets[source.as_int()];
+            if (source == our_king_) {
+                // Castlings are equal to plain king moves to the same square,
+                // so either of them being legal counts once.
+                for (BoardSquare destination : result + castlings) {
+                    const Move plain(source, destination);
+                    Move castling(source, destination);
+                    castling.SetCastling();
+                    if (result.get(destination) && IsLegalMove(plain, was_under_check, threats)) {
+                        add(plain);
+                    } else if (castlings.get(destination) && IsLegalMove(castling, was_under_check, threats)) {
+                        add(castling);
+                    }
+                }
+                continue;
+            }
+            if (result.empty()) continue;
+            if (NeedsApplying(source, was_under_check, threats)) {
+                for (BoardSquare destination : result) {
+                    const Move move(source, destination);
+                    if (IsLegalMove(move, was_under_check, threats)) add(move);
+                }
+                continue;
+            }
+            const BitBoard safe = (result - threats.landing_area) * PinMask(source, threats);
+            if (count >= capacity) {
+                // Only counting from here on.
+                count += safe.count();
+                for (BoardSquare destination : result - safe) {
+                    if (IsLegalMove(Move(source, destination), was_under_check, threats)) ++count;
+                }
+                continue;
+            }
+            for (BoardSquare destination : result) {
+                const Move move(source, destination);
+                if (safe.get(destination) || IsLegalMove(move, was_under_check, threats)) add(move);
+            }
+        }
+        return count;
+    }
+
+    bool ChessBoard::HasAnyLegalMove() const {
+        const bool was_under_check = IsUnderCheck();
+        const JumpThreats threats = was_under_check ? JumpThreats() : TheirJumpThreats();
+        // Whether any of @targets is a legal move of the piece on @source.
+        const auto any_legal = [&](BoardSquare source, const BitBoard& targets) {
+            if (targets.empty()) return false;
+            if (!NeedsApplying(source, was_under_check, threats) &&
+                (targets - threats.landing_area).intersects(PinMask(source, threats))) {
+                return true;
+            }
+            for (BoardSquare destination : targets) {
+                if (IsLegalMove(Move(source, destination), was_under_check, threats)) return true;
+            }
+            return false;
+        };
+
+        // Cheapest first: plain moves of pieces other than the king, which
+        // need neither their attacks nor our jump network.
+        for (BoardSquare source : our_pieces_ - our_king_) {
+            if (any_legal(source, PlainTargets(source, BitBoard()))) return true;
+        }
+        // King moves are always played to check them, so filter them first.
+        const BitBoard attacked = TheirAttacks();
+        if (any_legal(our_king_, PlainTargets(our_king_, attacked))) return true;
+        for (bool kingside : {true, false}) {
+            if (!CanCastle(kingside, attacked)) continue;
+            Move castling(our_king_, BoardSquare(0, kingside ? 6 : 2));
+            castling.SetCastling();
+            if (IsLegalMove(castling, was_under_check, threats)) return true;
+        }
+        // Then everything after jumps.
+        BitBoard targets[64];
+        AddJumpTargets(targets, attacked, ~0ULL, ~0ULL);
+        for (BoardSquare source : our_pieces_) {
+            if (any_legal(source, targets[source.as_int()])) return true;
+        }
+        return false;
+    }
+
+    bool ChessBoard::IsPseudoLegal(Move move) const {
+        const BoardSquare from = move.from();
+        const BoardSquare to = move.to();
+        if (!our_pieces_.get(from) || our_pieces_.get(to)) return false;
+        if (from == our_king_) {
+            // The generator leaves out king moves to squares attacked without jumps.
+            const BitBoard attacked = TheirAttacks();
+            if (move.castling()) {
+                if (to == BoardSquare(0, 6)) return CanCastle(true, attacked);
+                return to == BoardSquare(0, 2) && CanCastle(false, attacked);
+            }
+            if (attacked.get(to)) return false;
+        } else if (move.castling()) {
+            return false;
+        }
+        if (PlainTargets(from, BitBoard()).get(to)) return true;
+
+        // Otherwise the piece has to jump first. It may belong to several
+        // components, one per square it can jump to.
+        BitBoard landings;
+        sjadam::Components components;
+        sjadam::get_components(our_pieces_, their_pieces_, &components);
+        for (const auto& component : components) {
+            if (component.sources.get(from)) landings = landings + component.destinations;
+        }
+        if (landings.empty()) return false;
+        // Attacks are symmetric, so look from @to for a landing square instead
+        // of collecting the targets of every landing square.
+        const BitBoard occupied = our_pieces_ + their_pieces_;
+        if (from == our_king_) return kKingAttacks[to.as_int()].intersects(landings);
+        if ((pawns_ * kPawnMask).get(from)) {
+            return PawnTargets(landings.as_int(), ~occupied.as_int(), their_pieces_.as_int()).get(to);
+        }
+        if (!rooks_.get(from) && !bishops_.get(from)) return kKnightAttacks[to.as_int()].intersects(landings);
+        return (rooks_.get(from) && RookAttacks(to, occupied).intersects(landings)) ||
+               (bishops_.get(from) && BishopAttacks(to, occupied).intersects(landings));
+    }
+
+    namespace {
+        enum SeeValue {
+            kSeePawn = 100,
+            kSeeKnight = 300,
+            kSeeBishop = 300,
+            kSeeRook = 500,
+            kSeeQueen = 900,
+            kSeeKing = 20000,
+        };
+
+        // Bare piece placement used to play out the exchange. Side 0 is us,
+        // side 1 is them.
+        struct SeeBoard {
+            BitBoard pieces[2];
+            BitBoard rooks;
+            BitBoard bishops;
+            BitBoard pawns;
+            BitBoard kings;
+
+            int ValueAt(BoardSquare square) const {
+                if (kings.get(square)) return kSeeKing;
+                if (pawns.get(square)) return kSeePawn;
+                if (rooks.get(square) && bishops.get(square)) return kSeeQueen;
+                if (rooks.get(square)) return kSeeRook;
+                if (bishops.get(square)) return kSeeBishop;
+                return kSeeKnight;
+            }
+
+            void MovePiece(BoardSquare from, BoardSquare to, int side) {
+                for (BitBoard* board : {&pieces[0], &pieces[1], &rooks, &bishops, &pawns, &kings}) {
+                    board->reset(to);
+                }
+                for (BitBoard* board : {&rooks, &bishops, &pawns, &kings}) {
+                    board->set_if(to, board->get(from));
+                    board->reset(from);
+                }
+                pieces[side].reset(from);
+                pieces[side].set(to);
+            }
+
+            void Promote(BoardSquare square) {
+                pawns.reset(square);
+                rooks.set(square);
+                bishops.set(square);
+            }
+        };
+
+        // Finds the cheapest piece of @side which captures on @target, either
+        // directly or after jumping. Returns its value, or 0 if there is none.
+        int LeastValuableAttacker(const SeeBoard& board, int side, BoardSquare target,
+                                  BoardSquare* attacker) {
+            const BitBoard occupied = board.pieces[0] + board.pieces[1];
+            const int forward = side == 0 ? 1 : -1;
+            BitBoard pawn_landings;
+            for (auto direction : {-1, 1}) {
+                const auto row = target.row() - forward;
+                const auto col = target.col() + direction;
+                if (BoardSquare::IsValid(row, col)) pawn_landings.set(row, col);
+            }
+            const BitBoard king_landings = kKingAttacks[target.as_int()];
+            // Squares each piece can jump to before making its capture.
+            BitBoard jump_landings[64];
+            sjadam::Components components;
+            sjadam::get_components(board.pieces[side], board.pieces[1 - side], &components);
+            for (const auto& component : components) {
+                for (BoardSquare source : component.sources) {
+                    jump_landings[source.as_int()] = jump_landings[source.as_int()] + component.destinations;
+                }
+            }
+            int best = 0;
+            for (BoardSquare source : board.pieces[side]) {
+                const int value = board.ValueAt(source);
+                if (best != 0 && value >= best) continue;
+                BitBoard landings = jump_landings[source.as_int()];
+                landings.set(source);
+                bool attacks;
+                if (board.kings.get(source)) {
+                    attacks = landings.intersects(king_landings);
+                } else if (board.pawns.get(source)) {
+                    attacks = landings.intersects(pawn_landings);
+                } else if (board.rooks.get(source) || board.bishops.get(source)) {
+                    // Rays from the target, the moving piece leaves its square.
+                    const BitBoard blockers = occupied - source;
+                    BitBoard rays;
+                    if (board.rooks.get(source)) {
+                        rays = rays + RookAttacks(target, blockers);
+                    }
+                    if (board.bishops.get(source)) {
+                        rays = rays + BishopAttacks(target, blockers);
+                    }
+                    attacks = landings.intersects(rays);
+                } else {
+                    attacks = landings.intersects(kKnightAttacks[target.as_int()]);
+                }
+                if (attacks) {
+                    best = value;
+                    *attacker = source;
+                }
+            }
+            return best;
+        }
+    }  // namespace
+
+    int ChessBoard::StaticExchange(Move move) const {
+        SeeBoard board;
+        board.pieces[0] = our_pieces_;
+        board.pieces[1] = their_pieces_;
+        board.rooks = rooks_;
+        board.bishops = bishops_;
+        board.pawns = pawns_ * kPawnMask;
+        board.kings.set(our_king_);
+        board.kings.set(their_king_);
+
+        const BoardSquare from = move.from();
+        const BoardSquare target = move.to();
+        int gain[64];
+        int depth = 0;
+        gain[0] = 0;
+        if (their_pieces_.get(target)) {
+            gain[0] = board.ValueAt(target);
+        } else if (board.pawns.get(from) && target.row() == 5 && pawns_.get(7, target.col())) {
+            // En passant.
+            gain[0] = kSeePawn;
+            board.pieces[1].reset(4, target.col());
+            board.pawns.reset(4, target.col());
+        }
+        int on_target = board.ValueAt(from);
+        board.MovePiece(from, target, 0);
+        if (target.row() == 7 && from != our_king_) {
+            gain[0] += kSeeQueen - on_target;
+            on_target = kSeeQueen;
+            board.Promote(target);
+        }
+
+        int side = 1;
+        BoardSquare attacker;
+        while (depth + 1 < 64) {
+            int value = LeastValuableAttacker(board, side, target, &attacker);
+            if (value == 0) break;
+            ++depth;
+            gain[depth] = on_target - gain[depth - 1];
+            const bool promotion = value != kSeeKing && target.row() == (side == 0 ? 7 : 0);
+            if (promotion) {
+                gain[depth] += kSeeQueen - value;
+                value = kSeeQueen;
+            }
+            // Neither side can gain by going on.
+            if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+            board.MovePiece(attacker, target, side);
+            if (promotion) board.Promote(target);
+            on_target = value;
+            side = 1 - side;
+        }
+        while (depth > 0) {
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+            --depth;
+        }
+        return gain[0];
+    }
+
     std::vector<MoveExecution> ChessBoard::GenerateLegalMovesAndPositions() const {
         MoveList move_list = GeneratePseudolegalMoves();
         std::vector<MoveExecution> result;
@@ -733,6 +1131,39 @@ namespace lczero {
 
         if (!fen_str) throw Exception("Bad fen string: " + fen);
 
+        // Check the layout before setting any square: 8 ranks of 8 files, one
+        // king per side, and no pawns on the first and last rank, where they
+        // would be taken for en passant flags.
+        {
+            int ranks = 1;
+            int files = 0;
+            int kings[2] = {0, 0};
+            for (char c : board) {
+                if (c == '/') {
+                    if (files != 8) throw Exception("Bad fen string: " + fen);
+                    ++ranks;
+                    files = 0;
+                    continue;
+                }
+                if (std::isdigit(c)) {
+                    if (c == '0' || c == '9') throw Exception("Bad fen string: " + fen);
+                    files += c - '0';
+                } else {
+                    ++files;
+                    if (c == 'K') ++kings[0];
+                    if (c == 'k') ++kings[1];
+                    if ((c == 'P' || c == 'p') && (ranks == 1 || ranks == 8)) {
+                        throw Exception("Bad fen string: " + fen + " pawn on last rank");
+                    }
+                }
+                if (ranks > 8 || files > 8) throw Exception("Bad fen string: " + fen);
+            }
+            if (ranks != 8 || files != 8) throw Exception("Bad fen string: " + fen);
+            if (kings[0] != 1 || kings[1] != 1) {
+                throw Exception("Bad fen string: " + fen + " needs one king per side");
+            }
+        }
+
         for (char c : board) {
             if (c == '/') {
                 --row;
@@ -800,6 +1231,7 @@ namespace lczero {
                 throw Exception("Bad fen string: " + fen + " wrong en passant rank");
             pawns_.set((square.row() == 2) ? 0 : 7, square.col());
         }
+        ResetMaterialKey();
         if (who_to_move == "b" || who_to_move == "B") {
             Mirror();
         }
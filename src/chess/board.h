@@ -34,6 +34,7 @@
 namespace lczero {
 
 struct MoveExecution;
+struct PackedPosition;
 
 // Represents a board position.
 // Unlike most chess engines, the board is mirrored for black.
@@ -60,8 +61,14 @@ class ChessBoard {
   // Applies the move. (Only for "ours" (white)). Returns true if 50 moves
   // counter should be removed.
   bool ApplyMove(Move move);
-  // Checks if the square is under attack from "theirs" (black).
+  // Checks if the square is under attack from "theirs" (black), either with
+  // a plain chess move or after jumping.
   bool IsUnderAttack(BoardSquare square) const;
+  // All squares "theirs" (black) attack with plain chess moves. Our king
+  // doesn't block their sliders, so our king may not move to any of them.
+  // The other squares may still be attacked after jumps, which change when
+  // the king moves, so IsLegalMove() checks king moves by playing them.
+  BitBoard TheirAttacks() const;
   // Checks if "our" (white) king is under check.
   bool IsUnderCheck() const { return IsUnderAttack(our_king_); }
   // Checks whether at least one of the sides has mating material.
@@ -69,11 +76,62 @@ class ChessBoard {
   bool HasMatingMaterial() const;
   // Generates legal moves.
   MoveList GenerateLegalMoves() const;
+  // Legal moves of a kind, for quiescence and the like. They only build
+  // the targets they need instead of the whole move list, and list every
+  // move once. Between them they have every capture, promotion and
+  // checking move exactly once:
+  // Legal captures, en passant and capturing promotions included.
+  MoveList GenerateCaptures() const;
+  // Legal moves to the last rank which don't capture.
+  MoveList GeneratePromotions() const;
+  // Legal moves which neither capture nor promote after which the moved
+  // piece attacks their king. Checks by a piece it uncovers, or only after
+  // jumping, are not included.
+  MoveList GenerateChecks() const;
+  // Legal moves when our king is under check, each once. Pieces other than
+  // the king only try to capture or block a checker which attacks the king
+  // without jumping, so this is cheaper than GenerateLegalMoves() there.
+  MoveList GenerateEvasions() const;
   // Check whether pseudolegal move is legal.
   bool IsLegalMove(Move move, bool was_under_check) const;
+  // Whether GeneratePseudolegalMoves() has @move, including its castling
+  // flag, decided without generating moves. For moves from elsewhere: hash
+  // moves, book moves and user input.
+  bool IsPseudoLegal(Move move) const;
+  // Number of distinct legal moves, the same as the size of
+  // GenerateLegalMoves() after RemoveDuplicateMoves(). Collects target
+  // squares per piece instead of emitting every jump path, which makes it
+  // much cheaper for leaf perft and mobility.
+  int CountLegalMoves() const;
+  // Writes the first @capacity of those distinct legal moves to @moves,
+  // sorted by source and destination square, and returns the number of all
+  // of them. Doesn't allocate. A king move which is also a castling is
+  // written once, as the plain move when that is legal. kMaxLegalMoves
+  // always suffices.
+  int GenerateLegalMoves(Move* moves, int capacity) const;
+  static constexpr int kMaxLegalMoves = 1024;
+  // Whether there is any legal move, i.e. CountLegalMoves() != 0. Tries
+  // plain moves before building the jump network and stops at the first
+  // legal move, so it is cheap enough for mate and stalemate tests at every
+  // node.
+  bool HasAnyLegalMove() const;
+  // Static exchange evaluation of @move: material (pawn = 100) we win when
+  // both sides keep recapturing on the destination square with their
+  // cheapest piece, counting pieces which have to jump to get there.
+  int StaticExchange(Move move) const;
   // Returns a list of legal moves and board positions after the move is made.
   std::vector<MoveExecution> GenerateLegalMovesAndPositions() const;
 
+  // Flips the board left to right (file a becomes file h). Only keeps the
+  // position equivalent when no castling is possible.
+  void FlipHorizontal();
+  // Hash which is the same for all positions equivalent under left-right
+  // symmetry: the smaller of the hashes of the board and its flipped copy, or
+  // just Hash() while castling is still possible. If @flip is not nullptr,
+  // it's set to whether the canonical form is the flipped board, i.e.
+  // whether moves have to be flipped to and from the canonical form.
+  uint64_t CanonicalHash(bool* flip = nullptr) const;
+
   uint64_t Hash() const {
     return HashCat({our_pieces_.as_int(), their_pieces_.as_int(),
                     rooks_.as_int(), bishops_.as_int(), pawns_.as_int(),
@@ -83,6 +141,9 @@ class ChessBoard {
 
   class Castlings {
    public:
+    Castlings() = default;
+    explicit Castlings(uint8_t data) : data_(data) {}
+
     void set_we_can_00() { data_ |= 1; }
     void set_we_can_000() { data_ |= 2; }
     void set_they_can_00() { data_ |= 4; }
@@ -126,6 +187,8 @@ class ChessBoard {
   BitBoard ours() const { return our_pieces_; }
   BitBoard theirs() const { return their_pieces_; }
   BitBoard pawns() const;
+  // En passant flags (fake pawns on ranks 1 and 8, see pawns_).
+  BitBoard en_passant() const;
   BitBoard bishops() const { return bishops_ - rooks_; }
   BitBoard rooks() const { return rooks_ - bishops_; }
   BitBoard queens() const { return rooks_ * bishops_; }
@@ -140,6 +203,22 @@ class ChessBoard {
   const Castlings& castlings() const { return castlings_; }
   bool flipped() const { return flipped_; }
 
+  // Piece counts in 4 bit fields, one per MaterialType: ours in the low
+  // kMaterialTypes fields, theirs above. Kept up to date by ApplyMove() and
+  // Mirror(), so evaluation can look up material terms without counting.
+  enum MaterialType {
+    kMaterialPawn,
+    kMaterialKnight,
+    kMaterialBishop,
+    kMaterialRook,
+    kMaterialQueen,
+    kMaterialTypes
+  };
+  uint64_t material_key() const { return material_key_; }
+  static int MaterialCount(uint64_t key, bool theirs, MaterialType type) {
+    return (key >> (4 * (theirs * kMaterialTypes + type))) & 15;
+  }
+
   bool operator==(const ChessBoard& other) const {
     return (our_pieces_ == other.our_pieces_) &&
            (their_pieces_ == other.their_pieces_) && (rooks_ == other.rooks_) &&
@@ -152,6 +231,60 @@ class ChessBoard {
   bool operator!=(const ChessBoard& other) const { return !operator==(other); }
 
  private:
+  friend struct PackedPosition;
+
+  // Checks castling rights, empty squares between king and rook and that
+  // none of the king's squares are @attacked or attacked after a jump.
+  bool CanCastle(bool kingside, const BitBoard& attacked) const;
+  // Where their jumps reach, found once per position for legality checks.
+  // Moves which neither leave a jump_targets square nor enter a
+  // landing_area square can only take squares away from their jumps, so
+  // apart from pins they can't expose our king.
+  struct JumpThreats {
+    // Squares one jump away from their pieces and landing squares, which
+    // they could land on if the square was empty.
+    BitBoard jump_targets;
+    // Their landing squares and the squares next to them.
+    BitBoard landing_area;
+    // Squares their rooks (bishops) and queens stand on or jump to.
+    BitBoard rook_pinners;
+    BitBoard bishop_pinners;
+  };
+  JumpThreats TheirJumpThreats() const;
+  bool IsLegalMove(Move move, bool was_under_check,
+                   const JumpThreats& threats) const;
+  // Squares a piece on @from may move to without exposing our king: every
+  // square when it is not pinned, otherwise the pin line up to the pinner.
+  // Pinners may also be pieces which jump first, so a move off the pin line
+  // is not necessarily illegal.
+  BitBoard PinMask(BoardSquare from, const JumpThreats& threats) const;
+  // Whether IsLegalMove() plays moves from @source to check them, so that
+  // PinMask() alone doesn't tell.
+  bool NeedsApplying(BoardSquare source, bool was_under_check,
+                     const JumpThreats& threats) const;
+  // Adds the targets of every piece after jumping to targets[source]. King
+  // targets in @attacked are left out, only targets @within (@king_within
+  // for the king) are needed.
+  void AddJumpTargets(BitBoard targets[64], const BitBoard& attacked,
+                      const BitBoard& within, const BitBoard& king_within) const;
+  // Targets of the piece on @source without jumping, castling excluded.
+  BitBoard PlainTargets(BoardSquare source, const BitBoard& attacked) const;
+  // Both of the above for every piece, limited to @within (@king_within for
+  // the king).
+  void CollectTargets(BitBoard targets[64], const BitBoard& attacked,
+                      const BitBoard& within, const BitBoard& king_within) const;
+  // Appends the legal moves among targets[source] of every piece.
+  void AddLegalMoves(const BitBoard targets[64], MoveList* moves) const;
+
+  static constexpr uint64_t kMaterialSideMask = (1ull << (4 * kMaterialTypes)) - 1;
+  static uint64_t MaterialUnit(bool theirs, MaterialType type) {
+    return 1ull << (4 * (theirs * kMaterialTypes + type));
+  }
+  // Type of the piece (not the king) on @square.
+  MaterialType MaterialTypeAt(BoardSquare square) const;
+  // Counts all pieces, after the board was set up piece by piece.
+  void ResetMaterialKey();
+
   // All white pieces.
   BitBoard our_pieces_;
   // All black pieces.
@@ -170,6 +303,8 @@ class ChessBoard {
   BoardSquare their_king_;
   Castlings castlings_;
   bool flipped_ = false;  // aka "Black to move".
+  // See material_key().
+  uint64_t material_key_ = 0;
 };
 
 // Stores the move and state of the board after the move is done.
@@ -0,0 +1,98 @@
+#include "chess/notation.h"
+
+#include "JumpNetwork.h"
+#include "chess/attacks.h"
+#include "chess/tables.h"
+
+namespace lczero {
+
+namespace {
+
+std::string SquareName(BoardSquare square, bool flipped) {
+  if (flipped) square.Mirror();
+  return square.as_string();
+}
+
+// Squares the piece on @from reaches with one chess move when it stands on
+// @square, with the same rules as the generator: the piece doesn't leave
+// @from until the move is complete, and pawns only push two squares without
+// jumping first.
+BitBoard ChessTargets(const ChessBoard& board, BoardSquare from,
+                      BoardSquare square) {
+  const BitBoard occupied = board.ours() + board.theirs();
+  const int index = square.as_int();
+  if (board.our_king().get(from)) {
+    return tables::kKingAttacks[index] - board.ours();
+  }
+  if (board.pawns().get(from)) {
+    if (square.row() == 7) return {};
+    BitBoard result;
+    const BoardSquare push(square.row() + 1, square.col());
+    if (!occupied.get(push)) {
+      result.set(push);
+      const BoardSquare double_push(3, square.col());
+      if (square == from && square.row() == 1 && !occupied.get(double_push)) {
+        result.set(double_push);
+      }
+    }
+    // En passant flags of their pawns are on rank 8, the target is on rank 6.
+    // Only a plain capture from rank 5 takes en passant.
+    BitBoard capturable = board.theirs();
+    if (square == from) capturable = capturable + BitBoard(board.en_passant().as_int() >> 16);
+    return result + tables::kPawnAttacks[index] * capturable;
+  }
+  BitBoard result;
+  if (board.rooks().get(from) || board.queens().get(from)) {
+    result = result + RookAttacks(square, occupied);
+  }
+  if (board.bishops().get(from) || board.queens().get(from)) {
+    result = result + BishopAttacks(square, occupied);
+  }
+  if (result.empty()) result = tables::kKnightAttacks[index];
+  return result - board.ours();
+}
+
+std::string PieceLetter(const ChessBoard& board, BoardSquare from) {
+  if (board.our_king().get(from)) return "K";
+  if (board.pawns().get(from)) return "";
+  if (board.queens().get(from)) return "Q";
+  if (board.rooks().get(from)) return "R";
+  if (board.bishops().get(from)) return "B";
+  return "N";
+}
+
+}  // namespace
+
+std::string MoveToJumpNotation(const ChessBoard& board, Move move) {
+  const bool flipped = board.flipped();
+  const BoardSquare from = move.from();
+  const BoardSquare to = move.to();
+  if (move.castling()) return to.col() > from.col() ? "O-O" : "O-O-O";
+
+  std::string result = PieceLetter(board, from) + SquareName(from, flipped);
+  std::vector<BoardSquare> jumps;
+  if (!ChessTargets(board, from, from).get(to)) {
+    // Every move ends with a chess move, also one onto a landing square.
+    // Landings come closest first.
+    const sjadam::JumpPaths paths(from, board.ours(), board.theirs());
+    for (BoardSquare landing : paths.landings()) {
+      if (ChessTargets(board, from, landing).get(to)) {
+        jumps = paths.path(landing);
+        break;
+      }
+    }
+  }
+  for (BoardSquare jump : jumps) result += "^" + SquareName(jump, flipped);
+  const BoardSquare chess_from = jumps.empty() ? from : jumps.back();
+  const bool capture =
+      board.theirs().get(to) ||
+      (board.pawns().get(from) && chess_from.col() != to.col());
+  result += (capture ? "x" : "-") + SquareName(to, flipped);
+  if (to.row() == 7 && !board.our_king().get(from) &&
+      !board.queens().get(from)) {
+    result += "=Q";
+  }
+  return result;
+}
+
+}  // namespace lczero
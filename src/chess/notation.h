@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include "chess/board.h"
+
+namespace lczero {
+
+// Writes @move, a legal move of the side to move, in SAN-like notation which
+// spells out the jumps: the piece letter (none for pawns) and its square,
+// "^" and the landing square of every jump, then the chess move as "-" or
+// "x" and its destination, and "=Q" for promotions. Castling is "O-O"
+// or "O-O-O". Squares are from white's side, as in FEN, e.g. "Nb1^b3^d5xe7"
+// or "e2^e4-e5".
+//
+// When several jump paths lead to the move, the one with the fewest jumps is
+// shown.
+std::string MoveToJumpNotation(const ChessBoard& board, Move move);
+
+}  // namespace lczero
@@ -0,0 +1,92 @@
+#include "chess/packed_position.h"
+
+#include <cstring>
+#include "utils/exception.h"
+
+namespace lczero {
+
+PackedPosition PackedPosition::FromBoard(const ChessBoard& board) {
+  PackedPosition result;
+  std::memset(&result, 0, sizeof(result));
+  const BitBoard occupancy = board.our_pieces_ + board.their_pieces_;
+  if (occupancy.count() > 32) throw Exception("Too many pieces to pack");
+  result.occupancy[0] = static_cast<uint32_t>(occupancy.as_int());
+  result.occupancy[1] = static_cast<uint32_t>(occupancy.as_int() >> 32);
+  const BitBoard pawns = board.pawns();
+  int idx = 0;
+  for (BoardSquare square : occupancy) {
+    uint8_t piece;
+    if (square == board.our_king_ || square == board.their_king_) {
+      piece = kPackedKing;
+    } else if (pawns.get(square)) {
+      piece = kPackedPawn;
+    } else if (board.rooks_.get(square)) {
+      piece = board.bishops_.get(square) ? kPackedQueen : kPackedRook;
+    } else if (board.bishops_.get(square)) {
+      piece = kPackedBishop;
+    } else {
+      piece = kPackedKnight;
+    }
+    if (board.their_pieces_.get(square)) piece |= kTheirs;
+    result.pieces[idx / 2] |= piece << (4 * (idx % 2));
+    ++idx;
+  }
+  result.castlings = board.castlings_.as_int();
+  result.flags = board.flipped_ ? 1 : 0;
+  result.en_passant[0] = static_cast<uint8_t>(board.pawns_.as_int());
+  result.en_passant[1] = static_cast<uint8_t>(board.pawns_.as_int() >> 56);
+  return result;
+}
+
+ChessBoard PackedPosition::ToBoard() const {
+  ChessBoard board;
+  board.Clear();
+  int idx = 0;
+  for (BoardSquare square : occupied()) {
+    const uint8_t piece = (pieces[idx / 2] >> (4 * (idx % 2))) & 0xF;
+    ++idx;
+    if (piece & kTheirs) {
+      board.their_pieces_.set(square);
+    } else {
+      board.our_pieces_.set(square);
+    }
+    switch (piece & 7) {
+      case kPackedPawn:
+        board.pawns_.set(square);
+        break;
+      case kPackedKnight:
+        break;
+      case kPackedBishop:
+        board.bishops_.set(square);
+        break;
+      case kPackedRook:
+        board.rooks_.set(square);
+        break;
+      case kPackedQueen:
+        board.rooks_.set(square);
+        board.bishops_.set(square);
+        break;
+      case kPackedKing:
+        if (piece & kTheirs) {
+          board.their_king_ = square;
+        } else {
+          board.our_king_ = square;
+        }
+        break;
+      default:
+        throw Exception("Bad packed position");
+    }
+  }
+  board.pawns_ = board.pawns_ + BitBoard(en_passant[0]) +
+                 BitBoard(static_cast<uint64_t>(en_passant[1]) << 56);
+  board.castlings_ = ChessBoard::Castlings(castlings);
+  board.flipped_ = (flags & 1) != 0;
+  board.ResetMaterialKey();
+  return board;
+}
+
+bool PackedPosition::operator==(const PackedPosition& other) const {
+  return std::memcmp(this, &other, sizeof(PackedPosition)) == 0;
+}
+
+}  // namespace lczero
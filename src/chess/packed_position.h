@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include "chess/board.h"
+
+namespace lczero {
+
+// Fixed width (28 bytes) binary encoding of a ChessBoard.
+// The board is stored exactly as ChessBoard keeps it, i.e. from the point of
+// view of the side to move, so decoding gives an identical board.
+struct PackedPosition {
+  // All occupied squares, low and high half. Kept as two halves so that the
+  // struct only needs 4 byte alignment and packs into 32 byte records.
+  uint32_t occupancy[2];
+  // One nibble per occupied square, in the order of occupancy bits (low to
+  // high), low nibble first. Bits 0..2 is the piece type (see kPacked*),
+  // bit 3 is set for "their" pieces.
+  uint8_t pieces[16];
+  // ChessBoard::Castlings as int.
+  uint8_t castlings;
+  // Bit 0: board is flipped (black to move).
+  uint8_t flags;
+  // En passant flags, as rank 1 and rank 8 of the pawns bitboard.
+  uint8_t en_passant[2];
+
+  enum PieceType : uint8_t {
+    kPackedPawn = 1,
+    kPackedKnight = 2,
+    kPackedBishop = 3,
+    kPackedRook = 4,
+    kPackedQueen = 5,
+    kPackedKing = 6,
+  };
+  static constexpr uint8_t kTheirs = 8;
+
+  // Throws Exception if there are more than 32 pieces on the board.
+  static PackedPosition FromBoard(const ChessBoard& board);
+  ChessBoard ToBoard() const;
+
+  BitBoard occupied() const {
+    return occupancy[0] | (static_cast<uint64_t>(occupancy[1]) << 32);
+  }
+
+  bool operator==(const PackedPosition& other) const;
+};
+
+static_assert(sizeof(PackedPosition) == 28, "PackedPosition must be packed");
+
+}  // namespace lczero
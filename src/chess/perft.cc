@@ -0,0 +1,54 @@
+#include "chess/perft.h"
+
+#include "utils/hashcat.h"
+
+namespace lczero {
+
+PerftCache::PerftCache(size_t entries) {
+  size_t size = 1;
+  while (size < entries) size *= 2;
+  entries_.resize(size);
+  mask_ = size - 1;
+}
+
+uint64_t PerftCache::Key(const ChessBoard& board, int depth) {
+  // Zero key marks an empty entry.
+  return HashCat(board.CanonicalHash(), depth) | 1;
+}
+
+bool PerftCache::Probe(const ChessBoard& board, int depth, uint64_t* nodes) const {
+  const uint64_t key = Key(board, depth);
+  const Entry& entry = entries_[key & mask_];
+  if (entry.key != key) return false;
+  *nodes = entry.nodes;
+  return true;
+}
+
+void PerftCache::Store(const ChessBoard& board, int depth, uint64_t nodes) {
+  const uint64_t key = Key(board, depth);
+  Entry& entry = entries_[key & mask_];
+  entry.key = key;
+  entry.nodes = nodes;
+}
+
+uint64_t Perft(const ChessBoard& board, int depth, PerftCache* cache) {
+  if (depth == 0) return 1;
+  // Leaves only need the number of moves.
+  if (depth == 1) return board.CountLegalMoves();
+  uint64_t nodes = 0;
+  if (cache && cache->Probe(board, depth, &nodes)) return nodes;
+
+  Move moves[ChessBoard::kMaxLegalMoves];
+  const int count = board.GenerateLegalMoves(moves, ChessBoard::kMaxLegalMoves);
+  for (int i = 0; i < count; ++i) {
+    ChessBoard child(board);
+    child.ApplyMove(moves[i]);
+    child.Mirror();
+    nodes += Perft(child, depth - 1, cache);
+  }
+
+  if (cache) cache->Store(board, depth, nodes);
+  return nodes;
+}
+
+}  // namespace lczero
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "chess/board.h"
+
+namespace lczero {
+
+// Cache of subtree sizes, keyed by canonical position hash and depth, so
+// left-right mirrored positions share an entry.
+class PerftCache {
+ public:
+  // @entries is rounded up to a power of two.
+  explicit PerftCache(size_t entries = 1 << 20);
+
+  bool Probe(const ChessBoard& board, int depth, uint64_t* nodes) const;
+  void Store(const ChessBoard& board, int depth, uint64_t nodes);
+
+ private:
+  struct Entry {
+    uint64_t key = 0;
+    uint64_t nodes = 0;
+  };
+  static uint64_t Key(const ChessBoard& board, int depth);
+
+  std::vector<Entry> entries_;
+  uint64_t mask_;
+};
+
+// Counts leaf nodes of the legal move tree @depth plies deep. A move which
+// can be reached through several jump paths is counted once.
+uint64_t Perft(const ChessBoard& board, int depth, PerftCache* cache = nullptr);
+
+}  // namespace lczero
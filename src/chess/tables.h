@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "chess/bitboard.h"
+
+// Attack, ray and jump tables, all computed by the compiler. Squares are
+// indexed by BoardSquare::as_int() (row * 8 + col), from "our" side of the
+// board, i.e. pawns move towards row 7.
+
+namespace lczero {
+namespace tables {
+
+using SquareTable = std::array<BitBoard, 64>;
+using SquarePairTable = std::array<std::array<BitBoard, 64>, 64>;
+
+// Directions in the order JumpNetwork walks them.
+constexpr int kDirections[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1},
+                                   {0, 1},   {1, -1}, {1, 0},  {1, 1}};
+
+constexpr int kKnightDeltas[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2},
+                                     {1, -2},  {1, 2},  {2, -1},  {2, 1}};
+
+namespace detail {
+
+constexpr bool OnBoard(int row, int col) {
+  return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+constexpr uint64_t Bit(int row, int col) {
+  return uint64_t(1) << (row * 8 + col);
+}
+
+template <int N>
+constexpr SquareTable Leaper(const int (&deltas)[N][2]) {
+  SquareTable result{};
+  for (int square = 0; square < 64; ++square) {
+    uint64_t bits = 0;
+    for (int i = 0; i < N; ++i) {
+      const int row = square / 8 + deltas[i][0];
+      const int col = square % 8 + deltas[i][1];
+      if (OnBoard(row, col)) bits |= Bit(row, col);
+    }
+    result[square] = BitBoard(bits);
+  }
+  return result;
+}
+
+constexpr SquareTable PawnAttacks() {
+  constexpr int kDeltas[2][2] = {{1, -1}, {1, 1}};
+  return Leaper(kDeltas);
+}
+
+// Orthogonal or diagonal rays on an empty board.
+constexpr SquareTable Rays(bool diagonal) {
+  SquareTable result{};
+  for (int square = 0; square < 64; ++square) {
+    uint64_t bits = 0;
+    for (const auto& direction : kDirections) {
+      const bool is_diagonal = direction[0] != 0 && direction[1] != 0;
+      if (is_diagonal != diagonal) continue;
+      int row = square / 8 + direction[0];
+      int col = square % 8 + direction[1];
+      while (OnBoard(row, col)) {
+        bits |= Bit(row, col);
+        row += direction[0];
+        col += direction[1];
+      }
+    }
+    result[square] = BitBoard(bits);
+  }
+  return result;
+}
+
+// Ray in one direction of kDirections on an empty board.
+constexpr SquareTable DirectionRays(int direction) {
+  SquareTable result{};
+  for (int square = 0; square < 64; ++square) {
+    uint64_t bits = 0;
+    int row = square / 8 + kDirections[direction][0];
+    int col = square % 8 + kDirections[direction][1];
+    while (OnBoard(row, col)) {
+      bits |= Bit(row, col);
+      row += kDirections[direction][0];
+      col += kDirections[direction][1];
+    }
+    result[square] = BitBoard(bits);
+  }
+  return result;
+}
+
+constexpr std::array<SquareTable, 8> AllDirectionRays() {
+  std::array<SquareTable, 8> result{};
+  for (int i = 0; i < 8; ++i) result[i] = DirectionRays(i);
+  return result;
+}
+
+constexpr int Sign(int x) { return (x > 0) - (x < 0); }
+
+constexpr bool Aligned(int a, int b) {
+  const int rows = b / 8 - a / 8;
+  const int cols = b % 8 - a % 8;
+  return a != b && (rows == 0 || cols == 0 || rows == cols || rows == -cols);
+}
+
+constexpr SquarePairTable Between() {
+  SquarePairTable result{};
+  for (int a = 0; a < 64; ++a) {
+    for (int b = 0; b < 64; ++b) {
+      if (!Aligned(a, b)) continue;
+      const int drow = Sign(b / 8 - a / 8);
+      const int dcol = Sign(b % 8 - a % 8);
+      uint64_t bits = 0;
+      for (int row = a / 8 + drow, col = a % 8 + dcol; row * 8 + col != b;
+           row += drow, col += dcol) {
+        bits |= Bit(row, col);
+      }
+      result[a][b] = BitBoard(bits);
+    }
+  }
+  return result;
+}
+
+constexpr SquarePairTable Line() {
+  SquarePairTable result{};
+  for (int a = 0; a < 64; ++a) {
+    for (int b = 0; b < 64; ++b) {
+      if (!Aligned(a, b)) continue;
+      const int drow = Sign(b / 8 - a / 8);
+      const int dcol = Sign(b % 8 - a % 8);
+      uint64_t bits = Bit(a / 8, a % 8);
+      for (int sign = -1; sign <= 1; sign += 2) {
+        int row = a / 8 + sign * drow;
+        int col = a % 8 + sign * dcol;
+        while (OnBoard(row, col)) {
+          bits |= Bit(row, col);
+          row += sign * drow;
+          col += sign * dcol;
+        }
+      }
+      result[a][b] = BitBoard(bits);
+    }
+  }
+  return result;
+}
+
+// Square @distance steps away in every direction, -1 if it is off the board.
+constexpr std::array<std::array<int8_t, 8>, 64> Steps(int distance) {
+  std::array<std::array<int8_t, 8>, 64> result{};
+  for (int square = 0; square < 64; ++square) {
+    for (int i = 0; i < 8; ++i) {
+      const int row = square / 8 + kDirections[i][0] * distance;
+      const int col = square % 8 + kDirections[i][1] * distance;
+      // The jumped over square only counts when there is a landing square.
+      const bool jump = OnBoard(square / 8 + kDirections[i][0] * 2,
+                                square % 8 + kDirections[i][1] * 2);
+      result[square][i] = jump ? static_cast<int8_t>(row * 8 + col) : -1;
+    }
+  }
+  return result;
+}
+
+constexpr SquareTable StepMasks(int distance) {
+  SquareTable result{};
+  const auto steps = Steps(distance);
+  for (int square = 0; square < 64; ++square) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) {
+      if (steps[square][i] >= 0) bits |= uint64_t(1) << steps[square][i];
+    }
+    result[square] = BitBoard(bits);
+  }
+  return result;
+}
+
+}  // namespace detail
+
+inline constexpr SquareTable kKingAttacks = detail::Leaper(kDirections);
+inline constexpr SquareTable kKnightAttacks = detail::Leaper(kKnightDeltas);
+// Squares a pawn of ours attacks. By symmetry, also the squares their pawns
+// attack the square from.
+inline constexpr SquareTable kPawnAttacks = detail::PawnAttacks();
+// Rook and bishop moves on an empty board.
+inline constexpr SquareTable kRookRays = detail::Rays(false);
+inline constexpr SquareTable kBishopRays = detail::Rays(true);
+// Rays in each direction of kDirections, indexed [direction][square].
+inline constexpr std::array<SquareTable, 8> kDirectionRays =
+    detail::AllDirectionRays();
+
+// Squares strictly between two squares on a common rank, file or diagonal,
+// empty when they are not aligned.
+inline constexpr SquarePairTable kBetween = detail::Between();
+// The whole rank, file or diagonal through two aligned squares, empty when
+// they are not aligned.
+inline constexpr SquarePairTable kLine = detail::Line();
+
+// For every square and direction of kDirections, the square jumped over and
+// the landing square of a jump, -1 when the jump leaves the board.
+inline constexpr std::array<std::array<int8_t, 8>, 64> kJumpOver =
+    detail::Steps(1);
+inline constexpr std::array<std::array<int8_t, 8>, 64> kJumpLanding =
+    detail::Steps(2);
+// All squares which can be jumped over from a square, and all its landings.
+inline constexpr SquareTable kJumpOverMask = detail::StepMasks(1);
+inline constexpr SquareTable kJumpLandingMask = detail::StepMasks(2);
+
+}  // namespace tables
+}  // namespace lczero
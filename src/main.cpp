@@ -1,8 +1,36 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
+#include "book/book.h"
 #include "chess/bitboard.h"
 #include "chess/board.h"
+#include "chess/notation.h"
+#include "chess/perft.h"
+#include "match/match.h"
+#include "search/mate.h"
+#include "server/server.h"
+#include "tablebase/generator.h"
 #include "JumpNetwork.h"
 
+// Positions for "graph bench", also the training run of the PGO build
+// (scripts/pgo.sh).
+static const char* const kBenchPositions[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "4k3/8/8/3pP3/8/8/8/4K2R w K d6 0 1",
+        "8/8/4k3/8/2q5/8/4K3/8 w - - 0 1",
+};
+
 void print_source_dest_sq(const std::list<std::pair<std::list<lczero::BoardSquare>, std::list<lczero::BoardSquare>>>& sd) {
     for (auto p : sd) {
         printf("{ ");
@@ -31,7 +59,342 @@ void print_moves(lczero::ChessBoard& chessBoard) {
     }
 }
 
-int main() {
+// Runs perft on the bench positions and prints the node rate.
+int bench(int depth) {
+    uint64_t nodes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const char* fen : kBenchPositions) {
+        lczero::ChessBoard board;
+        board.SetFromFen(fen);
+        const uint64_t position_nodes = lczero::Perft(board, depth);
+        std::cout << fen << ": " << position_nodes << std::endl;
+        nodes += position_nodes;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Nodes: " << nodes << ", time: " << static_cast<int>(seconds * 1000) << " ms, nps: "
+              << static_cast<uint64_t>(nodes / seconds) << std::endl;
+    return 0;
+}
+
+int perft(int depth, const std::string& fen) {
+    lczero::ChessBoard board;
+    board.SetFromFen(fen);
+    std::cout << lczero::Perft(board, depth) << std::endl;
+    return 0;
+}
+
+// Plays a match between two engine settings, "a" and "b", e.g.
+//   graph match games=200 threads=4 a.depth=4 b.depth=4 b.mobility=5
+// Other keys: openings=<file>, hash=<MB>, max_plies=, elo0=, elo1=, alpha=,
+// beta=, and per engine depth, nodes, mobility, advancement, passed_pawn,
+// pawn_shield, bishop_pair, the piece values (pawn, knight, bishop, rook,
+// queen) and nnue=<network file>.
+int match(int argc, char** argv) {
+    lczero::EngineConfig engines[2];
+    engines[0].name = "a";
+    engines[1].name = "b";
+    lczero::MatchOptions options;
+    for (int i = 0; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto equals = arg.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << "Expected key=value: " << arg << std::endl;
+            return 1;
+        }
+        std::string key = arg.substr(0, equals);
+        const std::string value = arg.substr(equals + 1);
+        if (key == "games") {
+            options.games = std::stoi(value);
+        } else if (key == "threads") {
+            options.threads = std::stoi(value);
+        } else if (key == "max_plies") {
+            options.max_plies = std::stoi(value);
+        } else if (key == "openings") {
+            std::ifstream file(value);
+            if (!file) {
+                std::cerr << "Cannot open " << value << std::endl;
+                return 1;
+            }
+            options.openings = lczero::LoadOpenings(file);
+        } else if (key == "elo0") {
+            options.sprt.elo0 = std::stod(value);
+        } else if (key == "elo1") {
+            options.sprt.elo1 = std::stod(value);
+        } else if (key == "alpha") {
+            options.sprt.alpha = std::stod(value);
+        } else if (key == "beta") {
+            options.sprt.beta = std::stod(value);
+        } else if (key == "hash") {
+            engines[0].hash_mb = engines[1].hash_mb = std::stoul(value);
+        } else if (key.size() > 2 && (key[0] == 'a' || key[0] == 'b') && key[1] == '.') {
+            lczero::EngineConfig& engine = engines[key[0] - 'a'];
+            key = key.substr(2);
+            if (key == "depth") engine.limits.depth = std::stoi(value);
+            else if (key == "nodes") engine.limits.nodes = std::stoull(value);
+            else if (key == "mobility") engine.eval.mobility = std::stoi(value);
+            else if (key == "advancement") engine.eval.advancement = std::stoi(value);
+            else if (key == "passed_pawn") engine.eval.passed_pawn = std::stoi(value);
+            else if (key == "pawn_shield") engine.eval.pawn_shield = std::stoi(value);
+            else if (key == "bishop_pair") engine.eval.bishop_pair = std::stoi(value);
+            else if (key == "pawn") engine.eval.pawn = std::stoi(value);
+            else if (key == "knight") engine.eval.knight = std::stoi(value);
+            else if (key == "bishop") engine.eval.bishop = std::stoi(value);
+            else if (key == "rook") engine.eval.rook = std::stoi(value);
+            else if (key == "queen") engine.eval.queen = std::stoi(value);
+            else if (key == "nnue") engine.network = value;
+            else {
+                std::cerr << "Unknown engine option: " << arg << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    lczero::Match runner(engines[0], engines[1], options);
+    lczero::MatchStats stats;
+    try {
+        stats = runner.Run([&options](const lczero::MatchStats& stats) {
+            std::cout << stats.DebugString(options.sprt) << std::endl;
+        });
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    const double llr = stats.Llr(options.sprt);
+    if (llr >= options.sprt.upper_bound()) {
+        std::cout << "H1 accepted: a is stronger than b" << std::endl;
+    } else if (llr <= options.sprt.lower_bound()) {
+        std::cout << "H0 accepted" << std::endl;
+    } else {
+        std::cout << "Inconclusive" << std::endl;
+    }
+    return 0;
+}
+
+// Looks for mates by checks in the positions of a file with one FEN per
+// line, e.g.
+//   graph mate puzzles.fen moves=7 nodes=1000000
+// Other keys: hash=<MB>.
+int mate(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "Usage: graph mate <file> [moves=] [nodes=] [hash=]" << std::endl;
+        return 1;
+    }
+    int moves = 5;
+    uint64_t nodes = 1000000;
+    size_t hash_mb = 64;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "moves") {
+            moves = std::stoi(value);
+        } else if (key == "nodes") {
+            nodes = std::stoull(value);
+        } else if (key == "hash") {
+            hash_mb = std::stoul(value);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    std::ifstream file(argv[0]);
+    if (!file) {
+        std::cerr << "Can't open " << argv[0] << std::endl;
+        return 1;
+    }
+
+    lczero::MateSolver solver(hash_mb);
+    int solved = 0;
+    int total = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::string fen;
+    while (std::getline(file, fen)) {
+        if (fen.empty() || fen[0] == '#') continue;
+        lczero::ChessBoard board;
+        board.SetFromFen(fen);
+        const lczero::MateResult result = solver.Solve(board, moves, nodes);
+        ++total;
+        std::cout << fen << ": ";
+        if (result.status == lczero::MateStatus::kMate) {
+            ++solved;
+            std::cout << "mate in " << (result.line.size() + 1) / 2;
+            for (lczero::Move move : result.line) {
+                std::cout << " " << lczero::MoveToJumpNotation(board, move);
+                board.ApplyMove(move);
+                board.Mirror();
+            }
+        } else {
+            std::cout << (result.status == lczero::MateStatus::kNoMate ? "no mate" : "unknown");
+        }
+        std::cout << " (" << result.nodes << " nodes)" << std::endl;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Solved " << solved << " of " << total << " in " << static_cast<int>(seconds * 1000) << " ms"
+              << std::endl;
+    return 0;
+}
+
+// Builds an opening book from files of PGN games or of one game per line,
+// moves in coordinate notation, e.g.
+//   graph book book.bin games.pgn more.pgn max_ply=20
+int book(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: graph book <book> <games>... [max_ply=]" << std::endl;
+        return 1;
+    }
+    int max_ply = 30;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto equals = arg.find('=');
+        if (equals == std::string::npos) {
+            inputs.push_back(arg);
+            continue;
+        }
+        const std::string key = arg.substr(0, equals);
+        const std::string value = arg.substr(equals + 1);
+        if (key == "max_ply") {
+            max_ply = std::stoi(value);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    lczero::OpeningBookBuilder builder(max_ply);
+    for (const std::string& input : inputs) {
+        std::ifstream file(input);
+        if (!file) {
+            std::cerr << "Can't open " << input << std::endl;
+            return 1;
+        }
+        builder.AddGames(file);
+    }
+    try {
+        builder.Write(argv[0]);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << builder.size() << " entries to " << argv[0] << ", skipped "
+              << builder.skipped_games() << " games" << std::endl;
+    return 0;
+}
+
+// Generates the tablebase of a pawnless material and of everything it
+// converts into, e.g.
+//   graph tb KRvKN threads=8 dir=tables
+// Tables already in the directory are reused.
+int tb(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "Usage: graph tb <material> [threads=] [dir=]" << std::endl;
+        return 1;
+    }
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string directory = ".";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "threads") {
+            threads = std::stoi(value);
+        } else if (key == "dir") {
+            directory = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        lczero::TablebaseGenerator generator(directory, threads);
+        generator.Generate(argv[0]);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated " << argv[0] << " in " << static_cast<int>(seconds * 1000) << " ms" << std::endl;
+    return 0;
+}
+
+static lczero::AnalysisServer* running_server = nullptr;
+
+// Runs the analysis daemon (see src/server/server.h) until SIGINT or SIGTERM,
+// e.g.
+//   graph serve socket=/tmp/sjadam.sock threads=8 hash=512
+// Other keys: depth= and time=<ms> for requests without limits,
+// max_time=<ms>, nnue=<network file>.
+int serve(int argc, char** argv) {
+    lczero::ServerOptions options;
+    for (int i = 0; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "socket") {
+            options.socket_path = value;
+        } else if (key == "threads") {
+            options.threads = std::stoi(value);
+        } else if (key == "hash") {
+            options.hash_mb = std::stoul(value);
+        } else if (key == "depth") {
+            options.depth = std::stoi(value);
+        } else if (key == "time") {
+            options.time_ms = std::stoi(value);
+        } else if (key == "max_time") {
+            options.max_time_ms = std::stoi(value);
+        } else if (key == "nnue") {
+            options.network = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    try {
+        lczero::AnalysisServer server(options);
+        running_server = &server;
+        const auto stop = [](int) { running_server->Stop(); };
+        std::signal(SIGINT, stop);
+        std::signal(SIGTERM, stop);
+        server.Run();
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        running_server = nullptr;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        return bench(argc > 2 ? std::atoi(argv[2]) : 3);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "perft") == 0) {
+        return perft(std::atoi(argv[2]), argc > 3 ? argv[3] : lczero::ChessBoard::kStartingFen);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "match") == 0) {
+        return match(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "mate") == 0) {
+        return mate(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "serve") == 0) {
+        return serve(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "book") == 0) {
+        return book(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "tb") == 0) {
+        return tb(argc - 2, argv + 2);
+    }
+
     lczero::ChessBoard chessBoard;
     chessBoard.SetFromFen(lczero::ChessBoard::kStartingFen);
 
@@ -0,0 +1,177 @@
+#include "match/match.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace lczero {
+
+namespace {
+
+double EloToScore(double elo) { return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0)); }
+
+double ScoreToElo(double score) {
+  score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+  return 400.0 * std::log10(score / (1.0 - score));
+}
+
+}  // namespace
+
+GameResult PlayGame(const std::string& fen, Search* white, Search* black,
+                    const SearchLimits& white_limits,
+                    const SearchLimits& black_limits, int max_plies) {
+  ChessBoard board;
+  int no_capture_ply = 0;
+  board.SetFromFen(fen, &no_capture_ply);
+  // Hashes since the last irreversible move.
+  std::vector<uint64_t> history{board.Hash()};
+  // Result from the side to move's view: who lost.
+  auto loss = [&board]() {
+    return board.flipped() ? GameResult::kWhiteWon : GameResult::kBlackWon;
+  };
+
+  for (int ply = 0; ply < max_plies; ++ply) {
+    if (!board.HasMatingMaterial()) return GameResult::kDraw;
+    if (no_capture_ply >= 100) return GameResult::kDraw;
+    if (std::count(history.begin(), history.end(), history.back()) >= 3) {
+      return GameResult::kDraw;
+    }
+    if (!board.HasAnyLegalMove()) {
+      return board.IsUnderCheck() ? loss() : GameResult::kDraw;
+    }
+    const bool white_to_move = !board.flipped();
+    const SearchResult result =
+        white_to_move ? white->Run(board, white_limits)
+                      : black->Run(board, black_limits);
+    if (board.ApplyMove(result.best_move)) {
+      no_capture_ply = 0;
+      history.clear();
+    } else {
+      ++no_capture_ply;
+    }
+    board.Mirror();
+    history.push_back(board.Hash());
+  }
+  return GameResult::kDraw;
+}
+
+double SprtParams::lower_bound() const { return std::log(beta / (1.0 - alpha)); }
+
+double SprtParams::upper_bound() const { return std::log((1.0 - beta) / alpha); }
+
+double MatchStats::Score() const {
+  if (games() == 0) return 0.5;
+  return (wins + 0.5 * draws) / games();
+}
+
+double MatchStats::Elo() const { return ScoreToElo(Score()); }
+
+double MatchStats::EloError() const {
+  const int n = games();
+  if (n == 0) return 0.0;
+  const double score = Score();
+  const double variance =
+      (wins * std::pow(1.0 - score, 2) + draws * std::pow(0.5 - score, 2) +
+       losses * std::pow(score, 2)) /
+      n;
+  const double margin = 1.96 * std::sqrt(variance / n);
+  return (ScoreToElo(score + margin) - ScoreToElo(score - margin)) / 2.0;
+}
+
+double MatchStats::Llr(const SprtParams& sprt) const {
+  if (games() == 0) return 0.0;
+  // Half a game more of each outcome, so that the variance stays positive
+  // while one of them hasn't happened yet.
+  const double w = wins + 0.5;
+  const double d = draws + 0.5;
+  const double l = losses + 0.5;
+  const double n = w + d + l;
+  const double score = (w + 0.5 * d) / n;
+  const double variance =
+      (w * std::pow(1.0 - score, 2) + d * std::pow(0.5 - score, 2) +
+       l * std::pow(score, 2)) /
+      n;
+  const double s0 = EloToScore(sprt.elo0);
+  const double s1 = EloToScore(sprt.elo1);
+  return n * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * variance);
+}
+
+std::string MatchStats::DebugString(const SprtParams& sprt) const {
+  char buffer[200];
+  std::snprintf(buffer, sizeof(buffer),
+                "Games: %d, +%d =%d -%d, Elo: %.1f +/- %.1f, "
+                "LLR: %.2f (%.2f, %.2f) [%.1f, %.1f]",
+                games(), wins, draws, losses, Elo(), EloError(), Llr(sprt),
+                sprt.lower_bound(), sprt.upper_bound(), sprt.elo0, sprt.elo1);
+  return buffer;
+}
+
+std::vector<std::string> LoadOpenings(std::istream& input) {
+  std::vector<std::string> result;
+  std::string line;
+  while (std::getline(input, line)) {
+    const auto start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    const auto end = line.find_last_not_of(" \t\r");
+    result.push_back(line.substr(start, end - start + 1));
+  }
+  return result;
+}
+
+MatchStats Match::Run(std::function<void(const MatchStats&)> progress) {
+  if (!first_.network.empty()) {
+    first_network_.reset(new nnue::Network(first_.network));
+  }
+  if (!second_.network.empty()) {
+    second_network_.reset(new nnue::Network(second_.network));
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::max(1, options_.threads); ++i) {
+    threads.emplace_back(&Match::Worker, this, &progress);
+  }
+  for (auto& thread : threads) thread.join();
+  return stats_;
+}
+
+void Match::Worker(std::function<void(const MatchStats&)>* progress) {
+  TranspositionTable first_tt(first_.hash_mb);
+  TranspositionTable second_tt(second_.hash_mb);
+  Search first(&first_tt, first_.eval, first_network_.get());
+  Search second(&second_tt, second_.eval, second_network_.get());
+  while (!stop_) {
+    const int game = next_game_++;
+    if (game >= options_.games) break;
+    const std::string& fen =
+        options_.openings.empty()
+            ? ChessBoard::kStartingFen
+            : options_.openings[(game / 2) % options_.openings.size()];
+    first_tt.Clear();
+    second_tt.Clear();
+    const bool first_is_white = game % 2 == 0;
+    const GameResult result =
+        first_is_white
+            ? PlayGame(fen, &first, &second, first_.limits, second_.limits,
+                       options_.max_plies)
+            : PlayGame(fen, &second, &first, second_.limits, first_.limits,
+                       options_.max_plies);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) break;
+    if (result == GameResult::kDraw) {
+      ++stats_.draws;
+    } else if ((result == GameResult::kWhiteWon) == first_is_white) {
+      ++stats_.wins;
+    } else {
+      ++stats_.losses;
+    }
+    if (*progress) (*progress)(stats_);
+    const double llr = stats_.Llr(options_.sprt);
+    if (options_.stop_on_sprt && (llr <= options_.sprt.lower_bound() ||
+                                  llr >= options_.sprt.upper_bound())) {
+      stop_ = true;
+    }
+  }
+}
+
+}  // namespace lczero
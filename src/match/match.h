@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "search/search.h"
+
+namespace lczero {
+
+struct EngineConfig {
+  std::string name;
+  SearchLimits limits;
+  EvalParams eval;
+  // Network file (see neural/nnue.h) to evaluate with instead of @eval.
+  std::string network;
+  // Transposition table per game thread.
+  size_t hash_mb = 16;
+};
+
+enum class GameResult { kWhiteWon, kDraw, kBlackWon };
+
+// Plays one game from @fen. Adjudicated as a draw on threefold repetition,
+// the 50 move rule, insufficient material (HasMatingMaterial()) and after
+// @max_plies plies.
+GameResult PlayGame(const std::string& fen, Search* white, Search* black,
+                    const SearchLimits& white_limits,
+                    const SearchLimits& black_limits, int max_plies);
+
+// Sequential probability ratio test of H0: elo = elo0 against
+// H1: elo = elo1, using the normal approximation of the trinomial
+// (win/draw/loss) distribution. Every outcome counts half a game more, so
+// the test also moves when one side hasn't won a game yet.
+struct SprtParams {
+  double elo0 = 0.0;
+  double elo1 = 5.0;
+  double alpha = 0.05;
+  double beta = 0.05;
+
+  double lower_bound() const;
+  double upper_bound() const;
+};
+
+// Results from the first engine's point of view.
+struct MatchStats {
+  int wins = 0;
+  int draws = 0;
+  int losses = 0;
+
+  int games() const { return wins + draws + losses; }
+  double Score() const;
+  double Elo() const;
+  // Half width of the 95% confidence interval of Elo().
+  double EloError() const;
+  // Log likelihood ratio of H1 against H0.
+  double Llr(const SprtParams& sprt) const;
+  std::string DebugString(const SprtParams& sprt) const;
+};
+
+struct MatchOptions {
+  // Total games; every opening is played twice, once with each color.
+  int games = 100;
+  int threads = 1;
+  int max_plies = 400;
+  // Starting positions as FEN, the standard one if empty.
+  std::vector<std::string> openings;
+  SprtParams sprt;
+  // Stop as soon as the SPRT accepts either hypothesis.
+  bool stop_on_sprt = true;
+};
+
+// One FEN per line, empty lines and lines starting with '#' are skipped.
+std::vector<std::string> LoadOpenings(std::istream& input);
+
+// Plays games between two engine configurations on parallel threads.
+class Match {
+ public:
+  Match(const EngineConfig& first, const EngineConfig& second,
+        const MatchOptions& options)
+      : first_(first), second_(second), options_(options) {}
+
+  // Blocks until all games are played or the SPRT is decided. @progress is
+  // called after every game (one at a time). Throws Exception if a network
+  // can't be loaded.
+  MatchStats Run(std::function<void(const MatchStats&)> progress = nullptr);
+
+ private:
+  void Worker(std::function<void(const MatchStats&)>* progress);
+
+  const EngineConfig first_;
+  const EngineConfig second_;
+  const MatchOptions options_;
+  // Loaded once and shared by all threads.
+  std::unique_ptr<nnue::Network> first_network_;
+  std::unique_ptr<nnue::Network> second_network_;
+  std::atomic<int> next_game_{0};
+  std::atomic<bool> stop_{false};
+  std::mutex mutex_;
+  MatchStats stats_;
+};
+
+}  // namespace lczero
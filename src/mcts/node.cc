@@ -0,0 +1,88 @@
+#include "mcts/node.h"
+
+#include <utility>
+
+namespace lczero {
+
+Node* Node::FindChild(Move move) const {
+  for (int i = 0; i < num_children_; ++i) {
+    if (children_[i].move_ == move) return children_ + i;
+  }
+  return nullptr;
+}
+
+void Node::Expand(const ChessBoard& board, Arena::Slab* slab) {
+  MoveList moves = board.GenerateLegalMoves();
+  RemoveDuplicateMoves(&moves);
+
+  num_children_ = static_cast<uint16_t>(moves.size());
+  if (!moves.empty()) {
+    children_ = slab->NewArray<Node>(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+      children_[i].parent_ = this;
+      children_[i].move_ = moves[i];
+    }
+  }
+  expanded_ = true;
+}
+
+NodeTree::NodeTree() { ResetToPosition(ChessBoard::kStartingFen); }
+
+void NodeTree::ResetToPosition(const std::string& starting_fen) {
+  board_.SetFromFen(starting_fen);
+  ply_count_ = 0;
+  arenas_.clear();
+  arenas_.emplace_back(new Arena());
+  Arena::Slab slab(arenas_.back().get());
+  head_ = slab.NewArray<Node>(1);
+}
+
+void NodeTree::MakeMove(Move move) {
+  Node* new_head = head_->FindChild(move);
+  arenas_.emplace_back(new Arena());
+  if (!new_head) {
+    Arena::Slab slab(arenas_.back().get());
+    new_head = slab.NewArray<Node>(1);
+    new_head->move_ = move;
+  } else if (!arenas_[arenas_.size() - 2]->Contains(new_head)) {
+    new_head = CopySubtree(new_head);
+  }
+  head_ = new_head;
+  head_->parent_ = nullptr;
+  // The head is in one of the two newest arenas, and so is its subtree.
+  const size_t keep = arenas_.back()->Contains(head_) ? 1 : 2;
+  arenas_.erase(arenas_.begin(), arenas_.end() - keep);
+
+  board_.ApplyMove(move);
+  board_.Mirror();
+  ++ply_count_;
+}
+
+size_t NodeTree::bytes_reserved() const {
+  size_t result = 0;
+  for (const auto& arena : arenas_) result += arena->bytes_reserved();
+  return result;
+}
+
+Node* NodeTree::CopySubtree(const Node* node) {
+  Arena::Slab slab(arenas_.back().get());
+  Node* result = slab.NewArray<Node>(1);
+  *result = *node;
+  // (original, copy) pairs whose children still have to be copied.
+  std::vector<std::pair<const Node*, Node*>> pending = {{node, result}};
+  while (!pending.empty()) {
+    const Node* from = pending.back().first;
+    Node* to = pending.back().second;
+    pending.pop_back();
+    if (!from->children_) continue;
+    to->children_ = slab.NewArray<Node>(from->num_children_);
+    for (int i = 0; i < from->num_children_; ++i) {
+      to->children_[i] = from->children_[i];
+      to->children_[i].parent_ = to;
+      pending.emplace_back(from->children_ + i, to->children_ + i);
+    }
+  }
+  return result;
+}
+
+}  // namespace lczero
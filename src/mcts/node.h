@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "chess/board.h"
+#include "utils/arena.h"
+
+namespace lczero {
+
+// Node of the search tree. Nodes live in an Arena and are never deleted
+// individually; all children of a node are allocated as one contiguous array.
+class Node {
+ public:
+  Node() = default;
+
+  // Move which leads to this node, from the parent's point of view.
+  Move move() const { return move_; }
+  Node* parent() const { return parent_; }
+
+  uint32_t n() const { return n_; }
+  float q() const { return n_ ? w_ / n_ : 0.0f; }
+  void AddVisit(float value) {
+    ++n_;
+    w_ += value;
+  }
+
+  bool is_expanded() const { return expanded_; }
+  // Expanded node without children (mate or stalemate).
+  bool is_terminal() const { return expanded_ && num_children_ == 0; }
+
+  int num_children() const { return num_children_; }
+  Node* children() const { return children_; }
+  Node* child(int idx) const { return children_ + idx; }
+  // Returns child reached by @move, or nullptr if there is none.
+  Node* FindChild(Move move) const;
+
+  // Creates children for every (unique) legal move of @board in a single
+  // allocation from @slab.
+  void Expand(const ChessBoard& board, Arena::Slab* slab);
+
+ private:
+  friend class NodeTree;
+
+  Node* parent_ = nullptr;
+  Node* children_ = nullptr;
+  float w_ = 0.0f;
+  uint32_t n_ = 0;
+  Move move_;
+  uint16_t num_children_ = 0;
+  bool expanded_ = false;
+};
+
+// Search tree over a game. Every played move starts a new arena for the nodes
+// created after it. Nodes are always allocated after their parent, so the
+// subtree of the new root lives in the root's arena or newer ones, and older
+// arenas are dropped as a whole: one free per chunk instead of one delete per
+// node. When the root was allocated during the search just before the move,
+// it is detached in place and that arena stays alive with it, siblings and
+// all, for one more move. A root from any older arena (a line expanded
+// several moves ago) has its subtree copied into the new arena instead, so
+// at most two arenas are ever kept.
+class NodeTree {
+ public:
+  NodeTree();
+
+  void ResetToPosition(const std::string& starting_fen);
+  // Plays @move (from the point of view of the side to move), keeping its
+  // subtree. Slabs created before the call become invalid.
+  void MakeMove(Move move);
+
+  Node* GetCurrentHead() const { return head_; }
+  // Position at the head, from the point of view of the side to move.
+  const ChessBoard& HeadPosition() const { return board_; }
+  int GetPlyCount() const { return ply_count_; }
+
+  // Creates a new allocation slab. Every search thread should use its own.
+  Arena::Slab MakeSlab() { return Arena::Slab(arenas_.back().get()); }
+  // Arena new nodes are allocated from.
+  const Arena& arena() const { return *arenas_.back(); }
+  // Arenas still holding nodes of the tree, the root's first. At most 2.
+  size_t num_arenas() const { return arenas_.size(); }
+  // Bytes reserved by all of them.
+  size_t bytes_reserved() const;
+
+ private:
+  // Copies the subtree of @node into the newest arena and returns its copy.
+  Node* CopySubtree(const Node* node);
+
+  // Oldest first. Slabs allocate from the last one.
+  std::vector<std::unique_ptr<Arena>> arenas_;
+  Node* head_ = nullptr;
+  ChessBoard board_;
+  int ply_count_ = 0;
+};
+
+}  // namespace lczero
@@ -0,0 +1,159 @@
+#include "neural/encoder.h"
+
+#include <cstring>
+
+#include "utils/cpu.h"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(SJADAM_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+namespace lczero {
+
+namespace {
+
+// Byte b expanded into 8 bytes, byte i is bit i of b.
+struct ByteExpandTable {
+  ByteExpandTable() {
+    for (int b = 0; b < 256; ++b) {
+      uint64_t v = 0;
+      for (int i = 0; i < 8; ++i) {
+        if (b & (1 << i)) v |= 1ULL << (8 * i);
+      }
+      table[b] = v;
+    }
+  }
+  uint64_t table[256];
+};
+const ByteExpandTable kByteExpand;
+
+#if defined(__AVX2__) || defined(SJADAM_X86_DISPATCH)
+#define SJADAM_HAVE_AVX2_PATH 1
+#if defined(__AVX2__)
+#define SJADAM_AVX2_FUNCTION
+#else
+#define SJADAM_AVX2_FUNCTION SJADAM_TARGET("avx2")
+// Portable builds check the CPU once.
+const bool kUseAvx2 = CpuSupportsAvx2();
+#endif
+
+SJADAM_AVX2_FUNCTION
+void ExpandBitsAvx2(uint64_t bits, uint8_t* out) {
+  // Each lane broadcasts two bytes of the (32-bit) half to 8 bytes each, then
+  // every byte tests its own bit.
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i mask = _mm256_set1_epi64x(0x8040201008040201LL);
+  const __m256i ones = _mm256_set1_epi8(1);
+  for (int half = 0; half < 2; ++half) {
+    const __m256i v = _mm256_set1_epi32(static_cast<int>(bits >> (32 * half)));
+    const __m256i bytes = _mm256_shuffle_epi8(v, shuffle);
+    const __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, mask), mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32 * half),
+                        _mm256_and_si256(set, ones));
+  }
+}
+
+SJADAM_AVX2_FUNCTION
+void ExpandBitsAvx2(uint64_t bits, float* out) {
+  const __m256i mask = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  for (int i = 0; i < 8; ++i) {
+    const __m256i v = _mm256_set1_epi32(static_cast<int>((bits >> (8 * i)) & 0xFF));
+    const __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), mask);
+    _mm256_storeu_ps(out + 8 * i, _mm256_and_ps(_mm256_castsi256_ps(set), one));
+  }
+}
+#endif
+
+// Writes 64 values, one per bit of @bits.
+void ExpandBits(uint64_t bits, uint8_t* out) {
+#if defined(__AVX2__)
+  ExpandBitsAvx2(bits, out);
+#else
+#if defined(SJADAM_HAVE_AVX2_PATH)
+  if (kUseAvx2) return ExpandBitsAvx2(bits, out);
+#endif
+  for (int i = 0; i < 8; ++i) {
+    const uint64_t v = kByteExpand.table[(bits >> (8 * i)) & 0xFF];
+    std::memcpy(out + 8 * i, &v, sizeof(v));
+  }
+#endif
+}
+
+void ExpandBits(uint64_t bits, float* out) {
+#if defined(__AVX2__)
+  ExpandBitsAvx2(bits, out);
+#else
+#if defined(SJADAM_HAVE_AVX2_PATH)
+  if (kUseAvx2) return ExpandBitsAvx2(bits, out);
+#endif
+#if defined(__SSE2__)
+  const __m128i mask = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (int i = 0; i < 16; ++i) {
+    const __m128i v = _mm_set1_epi32(static_cast<int>((bits >> (4 * i)) & 0xF));
+    const __m128i set = _mm_cmpeq_epi32(_mm_and_si128(v, mask), mask);
+    _mm_storeu_ps(out + 4 * i, _mm_and_ps(_mm_castsi128_ps(set), one));
+  }
+#else
+  for (int i = 0; i < 64; ++i) out[i] = static_cast<float>((bits >> i) & 1);
+#endif
+#endif
+}
+
+template <typename T>
+void FillPlane(bool value, T* out) {
+  for (int i = 0; i < 64; ++i) out[i] = value ? 1 : 0;
+}
+
+template <typename T>
+void EncodePositionsImpl(const ChessBoard* boards, size_t count, T* output) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    const ChessBoard& board = boards[idx];
+    T* out = output + idx * kInputSize;
+    const BitBoard ours = board.ours();
+    const BitBoard theirs = board.theirs();
+    const BitBoard pawns = board.pawns();
+    const BitBoard bishops = board.bishops();
+    const BitBoard rooks = board.rooks();
+    const BitBoard queens = board.queens();
+
+    ExpandBits((ours * pawns).as_int(), out + 0 * 64);
+    ExpandBits(board.our_knights().as_int(), out + 1 * 64);
+    ExpandBits((ours * bishops).as_int(), out + 2 * 64);
+    ExpandBits((ours * rooks).as_int(), out + 3 * 64);
+    ExpandBits((ours * queens).as_int(), out + 4 * 64);
+    ExpandBits(board.our_king().as_int(), out + 5 * 64);
+    ExpandBits((theirs * pawns).as_int(), out + 6 * 64);
+    ExpandBits(board.their_knights().as_int(), out + 7 * 64);
+    ExpandBits((theirs * bishops).as_int(), out + 8 * 64);
+    ExpandBits((theirs * rooks).as_int(), out + 9 * 64);
+    ExpandBits((theirs * queens).as_int(), out + 10 * 64);
+    ExpandBits(board.their_king().as_int(), out + 11 * 64);
+
+    const auto& castlings = board.castlings();
+    FillPlane(castlings.we_can_00(), out + 12 * 64);
+    FillPlane(castlings.we_can_000(), out + 13 * 64);
+    FillPlane(castlings.they_can_00(), out + 14 * 64);
+    FillPlane(castlings.they_can_000(), out + 15 * 64);
+
+    // Flag on rank 8 means we can capture onto rank 6 of that file.
+    const uint64_t en_passant = (board.en_passant().as_int() >> 56) << 40;
+    ExpandBits(en_passant, out + 16 * 64);
+    FillPlane(board.flipped(), out + 17 * 64);
+  }
+}
+
+}  // namespace
+
+void EncodePositions(const ChessBoard* boards, size_t count, uint8_t* output) {
+  EncodePositionsImpl(boards, count, output);
+}
+
+void EncodePositions(const ChessBoard* boards, size_t count, float* output) {
+  EncodePositionsImpl(boards, count, output);
+}
+
+}  // namespace lczero
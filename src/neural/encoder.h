@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "chess/board.h"
+
+namespace lczero {
+
+// Input planes, each 64 values (a1, b1, ... h8), from the point of view of
+// the side to move:
+//   0..5   our pawns, knights, bishops, rooks, queens, king
+//   6..11  their pawns, knights, bishops, rooks, queens, king
+//   12..15 castlings: we can 0-0, we can 0-0-0, they can 0-0, they can 0-0-0
+//   16     en passant capture square
+//   17     side to move is black
+const int kInputPlanes = 18;
+const int kInputSize = kInputPlanes * 64;
+
+// Size of the policy head, see Move::as_nn_index().
+const int kPolicySize = 64 * 64;
+
+// Encodes @count boards into @output, which must have room for
+// count * kInputSize values. Values are 0 or 1.
+void EncodePositions(const ChessBoard* boards, size_t count, uint8_t* output);
+void EncodePositions(const ChessBoard* boards, size_t count, float* output);
+
+}  // namespace lczero
@@ -0,0 +1,224 @@
+#include "neural/nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include "utils/cpu.h"
+#include "utils/exception.h"
+
+#if defined(__AVX2__) || defined(SJADAM_X86_DISPATCH)
+#include <immintrin.h>
+#endif
+
+namespace lczero {
+namespace nnue {
+
+namespace {
+
+const char kMagic[4] = {'S', 'J', 'N', 'N'};
+const uint32_t kVersion = 1;
+const size_t kSectionAlignment = 64;
+const int kInputDimensions = 2 * kHalfDimensions;
+
+// Piece bitboards of @board indexed by color * 6 + type, color 0 being the
+// side to move.
+std::array<BitBoard, 12> PieceBoards(const ChessBoard& board) {
+  std::array<BitBoard, 12> result;
+  const BitBoard sides[2] = {board.ours(), board.theirs()};
+  for (int color = 0; color < 2; ++color) {
+    const BitBoard& side = sides[color];
+    result[color * 6 + 0] = board.pawns() * side;
+    result[color * 6 + 1] = color == 0 ? board.our_knights() : board.their_knights();
+    result[color * 6 + 2] = board.bishops() * side;
+    result[color * 6 + 3] = board.rooks() * side;
+    result[color * 6 + 4] = board.queens() * side;
+    result[color * 6 + 5] = color == 0 ? board.our_king() : board.their_king();
+  }
+  return result;
+}
+
+// Feature of piece @piece (color * 6 + type) on @square for @perspective.
+int FeatureIndex(int perspective, int piece, int square) {
+  if (perspective == 1) {
+    piece = piece < 6 ? piece + 6 : piece - 6;
+    square ^= 56;
+  }
+  return piece * 64 + square;
+}
+
+// The compiler vectorizes these.
+void AddFeature(const int16_t* weights, int16_t* values) {
+  for (int i = 0; i < kHalfDimensions; ++i) values[i] += weights[i];
+}
+
+void SubtractFeature(const int16_t* weights, int16_t* values) {
+  for (int i = 0; i < kHalfDimensions; ++i) values[i] -= weights[i];
+}
+
+uint8_t Clip(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), kActivationMax));
+}
+
+void HiddenLayerScalar(const uint8_t* input, const int8_t* weights,
+                       const int32_t* biases, uint8_t* output) {
+  for (int i = 0; i < kHiddenDimensions; ++i) {
+    const int8_t* row = weights + i * kInputDimensions;
+    int32_t sum = biases[i];
+    for (int j = 0; j < kInputDimensions; ++j) sum += input[j] * row[j];
+    output[i] = Clip(sum >> kHiddenShift);
+  }
+}
+
+#if defined(__AVX2__) || defined(SJADAM_X86_DISPATCH)
+#if defined(__AVX2__)
+const bool kUseAvx2 = true;
+#else
+const bool kUseAvx2 = CpuSupportsAvx2();
+#endif
+
+// Activations are at most 127, so the pairwise int16 sums of maddubs can't
+// saturate. Builds for VNNI CPUs do the whole multiply-add in one
+// instruction.
+#if !defined(__AVX2__)
+SJADAM_TARGET("avx2")
+#endif
+void HiddenLayerAvx2(const uint8_t* input, const int8_t* weights,
+                     const int32_t* biases, uint8_t* output) {
+#if !defined(__AVXVNNI__) && !(defined(__AVX512VNNI__) && defined(__AVX512VL__))
+  const __m256i ones = _mm256_set1_epi16(1);
+#endif
+  for (int i = 0; i < kHiddenDimensions; ++i) {
+    const int8_t* row = weights + i * kInputDimensions;
+    __m256i sum = _mm256_setzero_si256();
+    for (int j = 0; j < kInputDimensions; j += 32) {
+      const __m256i in =
+          _mm256_load_si256(reinterpret_cast<const __m256i*>(input + j));
+      const __m256i w =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j));
+#if defined(__AVXVNNI__)
+      sum = _mm256_dpbusd_avx_epi32(sum, in, w);
+#elif defined(__AVX512VNNI__) && defined(__AVX512VL__)
+      sum = _mm256_dpbusd_epi32(sum, in, w);
+#else
+      sum = _mm256_add_epi32(
+          sum, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+#endif
+    }
+    __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                  _mm256_extracti128_si256(sum, 1));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+    output[i] = Clip((_mm_cvtsi128_si32(total) + biases[i]) >> kHiddenShift);
+  }
+}
+#endif
+
+void HiddenLayer(const uint8_t* input, const int8_t* weights,
+                 const int32_t* biases, uint8_t* output) {
+#if defined(__AVX2__) || defined(SJADAM_X86_DISPATCH)
+  if (kUseAvx2) return HiddenLayerAvx2(input, weights, biases, output);
+#endif
+  HiddenLayerScalar(input, weights, biases, output);
+}
+
+}  // namespace
+
+Network::Network(const std::string& filename) : file_(filename) {
+  NnueHeader header;
+  if (file_.size() < sizeof(header)) {
+    throw Exception("Network file too short: " + filename);
+  }
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    throw Exception("Not a network file: " + filename);
+  }
+  if (header.features != kFeatures ||
+      header.half_dimensions != kHalfDimensions ||
+      header.hidden_dimensions != kHiddenDimensions) {
+    throw Exception("Unsupported network dimensions: " + filename);
+  }
+
+  size_t offset = sizeof(header);
+  const auto section = [this, &offset, &filename](size_t bytes) {
+    offset = (offset + kSectionAlignment - 1) / kSectionAlignment *
+             kSectionAlignment;
+    if (offset + bytes > file_.size()) {
+      throw Exception("Network file too short: " + filename);
+    }
+    const char* result = file_.data() + offset;
+    offset += bytes;
+    return result;
+  };
+  // Mappings are page aligned, so the sections are 64 byte aligned too.
+  feature_weights_ = reinterpret_cast<const int16_t*>(
+      section(sizeof(int16_t) * kFeatures * kHalfDimensions));
+  feature_biases_ = reinterpret_cast<const int16_t*>(
+      section(sizeof(int16_t) * kHalfDimensions));
+  hidden_weights_ = reinterpret_cast<const int8_t*>(
+      section(sizeof(int8_t) * kHiddenDimensions * kInputDimensions));
+  hidden_biases_ = reinterpret_cast<const int32_t*>(
+      section(sizeof(int32_t) * kHiddenDimensions));
+  output_weights_ = reinterpret_cast<const int8_t*>(
+      section(sizeof(int8_t) * kHiddenDimensions));
+  std::memcpy(&output_bias_, section(sizeof(int32_t)), sizeof(int32_t));
+}
+
+void Network::Refresh(const ChessBoard& board, Accumulator* accumulator) const {
+  const auto pieces = PieceBoards(board);
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    int16_t* values = accumulator->values[perspective].data();
+    std::copy(feature_biases_, feature_biases_ + kHalfDimensions, values);
+    for (int piece = 0; piece < 12; ++piece) {
+      for (BoardSquare square : pieces[piece]) {
+        const int feature = FeatureIndex(perspective, piece, square.as_int());
+        AddFeature(feature_weights_ + feature * kHalfDimensions, values);
+      }
+    }
+  }
+}
+
+void Network::Update(const ChessBoard& before, const ChessBoard& after,
+                     const Accumulator& previous,
+                     Accumulator* accumulator) const {
+  // Comparing the boards catches captures, promotions, castling and en
+  // passant alike. Usually two or three features change.
+  const auto old_pieces = PieceBoards(before);
+  const auto new_pieces = PieceBoards(after);
+  if (accumulator != &previous) *accumulator = previous;
+  for (int piece = 0; piece < 12; ++piece) {
+    if (old_pieces[piece] == new_pieces[piece]) continue;
+    const BitBoard removed = old_pieces[piece] - new_pieces[piece];
+    const BitBoard added = new_pieces[piece] - old_pieces[piece];
+    for (int perspective = 0; perspective < 2; ++perspective) {
+      int16_t* values = accumulator->values[perspective].data();
+      for (BoardSquare square : removed) {
+        const int feature = FeatureIndex(perspective, piece, square.as_int());
+        SubtractFeature(feature_weights_ + feature * kHalfDimensions, values);
+      }
+      for (BoardSquare square : added) {
+        const int feature = FeatureIndex(perspective, piece, square.as_int());
+        AddFeature(feature_weights_ + feature * kHalfDimensions, values);
+      }
+    }
+  }
+}
+
+int Network::Evaluate(const Accumulator& accumulator) const {
+  alignas(32) uint8_t input[kInputDimensions];
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    for (int i = 0; i < kHalfDimensions; ++i) {
+      input[perspective * kHalfDimensions + i] =
+          Clip(accumulator.values[perspective][i]);
+    }
+  }
+  uint8_t hidden[kHiddenDimensions];
+  HiddenLayer(input, hidden_weights_, hidden_biases_, hidden);
+  int32_t output = output_bias_;
+  for (int i = 0; i < kHiddenDimensions; ++i) {
+    output += hidden[i] * output_weights_[i];
+  }
+  return output / kOutputScale;
+}
+
+}  // namespace nnue
+}  // namespace lczero
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "chess/board.h"
+#include "utils/mapped_file.h"
+
+namespace lczero {
+namespace nnue {
+
+// Efficiently updatable network for alpha-beta search. The inputs are one
+// piece-square feature per piece, seen from both sides:
+//   (color * 6 + type) * 64 + square
+// with color 0 for the side the perspective belongs to, types pawn,
+// knight, bishop, rook, queen, king, and squares from that side's view
+// (the other side's features are flipped vertically).
+//
+// The first layer is summed per perspective into an Accumulator, which
+// moves only change in a few inputs. After that:
+//   clipped ReLU of both halves (side to move first) as uint8 -> hidden
+//   layer of kHiddenDimensions with int8 weights -> clipped ReLU -> output.
+const int kFeatures = 12 * 64;
+const int kHalfDimensions = 256;
+const int kHiddenDimensions = 32;
+// Activations are clipped to [0, kActivationMax].
+const int kActivationMax = 127;
+// Hidden layer sums are shifted right by this before clipping.
+const int kHiddenShift = 6;
+// The output divided by this is the score in centipawns.
+const int kOutputScale = 16;
+
+// File layout, all little endian: NnueHeader, then each of these arrays
+// starting at a multiple of 64 bytes:
+//   int16 feature_weights[kFeatures][kHalfDimensions]
+//   int16 feature_biases[kHalfDimensions]
+//   int8  hidden_weights[kHiddenDimensions][2 * kHalfDimensions]
+//   int32 hidden_biases[kHiddenDimensions]
+//   int8  output_weights[kHiddenDimensions]
+//   int32 output_bias
+struct NnueHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t features;
+  uint32_t half_dimensions;
+  uint32_t hidden_dimensions;
+};
+
+// First layer outputs for one position, for the side to move ([0]) and the
+// other side ([1]).
+struct Accumulator {
+  // ChessBoard::Mirror() swaps the sides, and with them the perspectives.
+  void Mirror() { std::swap(values[0], values[1]); }
+
+  alignas(32) std::array<std::array<int16_t, kHalfDimensions>, 2> values;
+};
+
+// Network weights, used straight from the mapped file. Thread safe.
+class Network {
+ public:
+  // Throws Exception if @filename isn't a network file of the dimensions
+  // above.
+  explicit Network(const std::string& filename);
+
+  // Computes @accumulator of @board from scratch.
+  void Refresh(const ChessBoard& board, Accumulator* accumulator) const;
+  // Computes @accumulator of @after from @previous, the accumulator of
+  // @before. @after is @before after ApplyMove() but before Mirror(), so
+  // the accumulator has to be mirrored along with the board.
+  void Update(const ChessBoard& before, const ChessBoard& after,
+              const Accumulator& previous, Accumulator* accumulator) const;
+  // Score of the position in centipawns from the side to move's view.
+  int Evaluate(const Accumulator& accumulator) const;
+
+ private:
+  MappedFile file_;
+  const int16_t* feature_weights_;
+  const int16_t* feature_biases_;
+  const int8_t* hidden_weights_;
+  const int32_t* hidden_biases_;
+  const int8_t* output_weights_;
+  int32_t output_bias_;
+};
+
+}  // namespace nnue
+}  // namespace lczero
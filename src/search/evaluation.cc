@@ -0,0 +1,156 @@
+#include "search/evaluation.h"
+
+#include "chess/tables.h"
+#include "utils/hashcat.h"
+
+namespace lczero {
+
+namespace {
+
+const size_t kMaterialEntries = 1 << 12;
+const size_t kPawnEntries = 1 << 14;
+const uint64_t kFileA = 0x0101010101010101ULL;
+
+// Material balance, bishop pair included, from the counts in @key.
+int Material(uint64_t key, const EvalParams& params) {
+  int score = 0;
+  for (int side = 0; side < 2; ++side) {
+    const bool theirs = side == 1;
+    const auto count = [key, theirs](ChessBoard::MaterialType type) {
+      return ChessBoard::MaterialCount(key, theirs, type);
+    };
+    const int material =
+        count(ChessBoard::kMaterialPawn) * params.pawn +
+        count(ChessBoard::kMaterialKnight) * params.knight +
+        count(ChessBoard::kMaterialBishop) * params.bishop +
+        count(ChessBoard::kMaterialRook) * params.rook +
+        count(ChessBoard::kMaterialQueen) * params.queen +
+        (count(ChessBoard::kMaterialBishop) >= 2 ? params.bishop_pair : 0);
+    score += theirs ? -material : material;
+  }
+  return score;
+}
+
+// K v K and a single knight or bishop against a bare king, as in
+// ChessBoard::HasMatingMaterial().
+bool IsDrawnMaterial(uint64_t key) {
+  int minors = 0;
+  for (int side = 0; side < 2; ++side) {
+    const bool theirs = side == 1;
+    if (ChessBoard::MaterialCount(key, theirs, ChessBoard::kMaterialPawn) ||
+        ChessBoard::MaterialCount(key, theirs, ChessBoard::kMaterialRook) ||
+        ChessBoard::MaterialCount(key, theirs, ChessBoard::kMaterialQueen)) {
+      return false;
+    }
+    minors +=
+        ChessBoard::MaterialCount(key, theirs, ChessBoard::kMaterialKnight) +
+        ChessBoard::MaterialCount(key, theirs, ChessBoard::kMaterialBishop);
+  }
+  return minors <= 1;
+}
+
+// Passed pawn rows and shield pawns of the side whose pawns move up the
+// board. The other side is scored on a mirrored copy of the bitboards.
+int PawnTerms(const BitBoard& ours, const BitBoard& theirs, BoardSquare king,
+              const EvalParams& params) {
+  int score = 0;
+  if (params.passed_pawn != 0) {
+    for (BoardSquare pawn : ours) {
+      // Files next to the pawn's, and rows ahead of it.
+      uint64_t files = kFileA << pawn.col();
+      files |= ((files << 1) & ~kFileA) | ((files >> 1) & ~(kFileA << 7));
+      // Pawns promote on the last row, so they are never on it.
+      const uint64_t ahead = ~0ull << (8 * (pawn.row() + 1));
+      if (!theirs.intersects(files & ahead)) {
+        score += params.passed_pawn * pawn.row();
+      }
+    }
+  }
+  if (params.pawn_shield != 0 && king.row() < 7) {
+    const uint64_t front = 0xFFull << (8 * (king.row() + 1));
+    score += params.pawn_shield *
+             (ours * tables::kKingAttacks[king.as_int()] * front).count();
+  }
+  return score;
+}
+
+int Pawns(const ChessBoard& board, const EvalParams& params) {
+  const BitBoard ours = board.pawns() * board.ours();
+  const BitBoard theirs = board.pawns() * board.theirs();
+  BitBoard their_view = theirs;
+  BitBoard our_view = ours;
+  their_view.Mirror();
+  our_view.Mirror();
+  BoardSquare their_king = *board.their_king().begin();
+  their_king.Mirror();
+  return PawnTerms(ours, theirs, *board.our_king().begin(), params) -
+         PawnTerms(their_view, our_view, their_king, params);
+}
+
+// Sum of rows of non-king pieces, counted from the side's own first rank.
+int Advancement(const BitBoard& pieces, bool theirs) {
+  int rows = 0;
+  for (BoardSquare square : pieces) {
+    rows += theirs ? 7 - square.row() : square.row();
+  }
+  return rows;
+}
+
+}  // namespace
+
+EvalCache::EvalCache() : material_(kMaterialEntries), pawns_(kPawnEntries) {}
+
+int Evaluate(const ChessBoard& board, const EvalParams& params,
+             EvalCache* cache) {
+  const uint64_t material_key = board.material_key();
+  int score;
+  bool draw;
+  if (cache) {
+    EvalCache::MaterialEntry* entry = cache->material(material_key);
+    if (entry->key != material_key) {
+      entry->key = material_key;
+      entry->score = static_cast<int16_t>(Material(material_key, params));
+      entry->draw = IsDrawnMaterial(material_key);
+    }
+    score = entry->score;
+    draw = entry->draw;
+  } else {
+    score = Material(material_key, params);
+    draw = IsDrawnMaterial(material_key);
+  }
+  if (draw) return 0;
+
+  if (params.passed_pawn != 0 || params.pawn_shield != 0) {
+    if (cache) {
+      const uint64_t pawn_key =
+          HashCat({(board.pawns() * board.ours()).as_int(),
+                   (board.pawns() * board.theirs()).as_int(),
+                   board.our_king().as_int(), board.their_king().as_int()});
+      EvalCache::PawnEntry* entry = cache->pawns(pawn_key);
+      if (entry->key != pawn_key) {
+        entry->key = pawn_key;
+        entry->score = static_cast<int16_t>(Pawns(board, params));
+      }
+      score += entry->score;
+    } else {
+      score += Pawns(board, params);
+    }
+  }
+
+  const BitBoard ours = board.ours();
+  const BitBoard theirs = board.theirs();
+  if (params.advancement != 0) {
+    score += params.advancement *
+             (Advancement(ours - board.our_king(), false) -
+              Advancement(theirs - board.their_king(), true));
+  }
+  if (params.mobility != 0) {
+    ChessBoard mirrored(board);
+    mirrored.Mirror();
+    score += params.mobility *
+             (board.CountLegalMoves() - mirrored.CountLegalMoves());
+  }
+  return score;
+}
+
+}  // namespace lczero
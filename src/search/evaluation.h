@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "chess/board.h"
+
+namespace lczero {
+
+// Tunable evaluation terms, so that match runs can compare settings.
+struct EvalParams {
+  int pawn = 100;
+  int knight = 300;
+  int bishop = 300;
+  int rook = 500;
+  int queen = 900;
+  // Per row closer to the last rank, where every piece promotes.
+  int advancement = 0;
+  // Per legal move more than the opponent. Costs two move counts per call.
+  int mobility = 0;
+  // Per row a passed pawn (no enemy pawn ahead of it on its own or the
+  // neighbouring files) has advanced.
+  int passed_pawn = 0;
+  // Per own pawn on the three squares in front of the king.
+  int pawn_shield = 0;
+  // For having two or more bishops.
+  int bishop_pair = 0;
+};
+
+// Evaluation terms which only depend on the material (material_key()) or
+// on the pawns and kings, cached per thread. Those change in few moves, so
+// most lookups hit. Only valid for one EvalParams.
+class EvalCache {
+ public:
+  EvalCache();
+
+  struct MaterialEntry {
+    uint64_t key = ~0ull;
+    int16_t score = 0;
+    // Neither side has the material to mate, whatever the squares.
+    bool draw = false;
+  };
+
+  struct PawnEntry {
+    uint64_t key = 0;
+    int16_t score = 0;
+  };
+
+  MaterialEntry* material(uint64_t key) {
+    return &material_[Hash(key) & (material_.size() - 1)];
+  }
+  PawnEntry* pawns(uint64_t key) { return &pawns_[key & (pawns_.size() - 1)]; }
+
+ private:
+  std::vector<MaterialEntry> material_;
+  std::vector<PawnEntry> pawns_;
+};
+
+// Static score of @board in centipawns from the side to move's view. Looks
+// up material and pawn terms in @cache when there is one.
+int Evaluate(const ChessBoard& board, const EvalParams& params,
+             EvalCache* cache = nullptr);
+
+}  // namespace lczero
@@ -0,0 +1,218 @@
+#include "search/mate.h"
+
+#include <algorithm>
+
+namespace lczero {
+
+namespace {
+
+const uint32_t kInfinity = 1u << 30;
+
+uint64_t Key(const ChessBoard& board, int depth) {
+  return HashCat(board.Hash(), static_cast<uint64_t>(depth));
+}
+
+uint32_t Add(uint32_t a, uint32_t b) { return std::min(a + b, kInfinity); }
+
+}  // namespace
+
+MateSolver::MateSolver(size_t megabytes) {
+  size_t size = 2;
+  while (size * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) size *= 2;
+  table_.resize(size);
+  mask_ = size / 2 - 1;
+}
+
+MateSolver::Entry MateSolver::Lookup(uint64_t key) const {
+  const Entry* bucket = &table_[2 * (key & mask_)];
+  for (int i = 0; i < 2; ++i) {
+    if (bucket[i].key == key) return bucket[i];
+  }
+  Entry entry;
+  entry.key = key;
+  return entry;
+}
+
+void MateSolver::Store(const Entry& entry) {
+  Entry* bucket = &table_[2 * (entry.key & mask_)];
+  Entry* slot = bucket[0].work <= bucket[1].work ? &bucket[0] : &bucket[1];
+  for (int i = 0; i < 2; ++i) {
+    if (bucket[i].key == entry.key) slot = &bucket[i];
+  }
+  *slot = entry;
+}
+
+std::vector<MateSolver::Child> MateSolver::Children(const ChessBoard& board,
+                                                    int depth) const {
+  std::vector<Child> result;
+  const bool attacker = depth % 2 == 1;
+  MoveList moves;
+  if (attacker) {
+    moves = board.GenerateLegalMoves();
+    RemoveDuplicateMoves(&moves);
+  } else {
+    moves = board.GenerateEvasions();
+  }
+  result.reserve(moves.size());
+  for (Move move : moves) {
+    Child child{move, board, 0};
+    child.board.ApplyMove(move);
+    child.board.Mirror();
+    if (attacker && !child.board.IsUnderCheck()) continue;
+    child.key = Key(child.board, depth - 1);
+    result.push_back(child);
+  }
+  return result;
+}
+
+void MateSolver::Mid(const ChessBoard& board, int depth, uint32_t pn_threshold,
+                     uint32_t dn_threshold) {
+  ++nodes_;
+  if (max_nodes_ && nodes_ >= max_nodes_) aborted_ = true;
+  const uint64_t start = nodes_;
+  const bool attacker = depth % 2 == 1;
+  Entry entry = Lookup(Key(board, depth));
+
+  // Out of plies the defender survived unless mated already.
+  const std::vector<Child> children =
+      depth == 0 ? std::vector<Child>() : Children(board, depth);
+  if (children.empty()) {
+    // Without a check left the attacker failed; without an evasion the
+    // defender is mated.
+    const bool mate = !attacker && (depth != 0 || !board.HasAnyLegalMove());
+    entry.pn = mate ? 0 : kInfinity;
+    entry.dn = mate ? kInfinity : 0;
+    entry.plies = 0;
+    entry.work = 1;
+    Store(entry);
+    return;
+  }
+
+  std::vector<Entry> entries(children.size());
+  while (true) {
+    // The attacker needs one child proven, the defender one disproven.
+    uint32_t pn = attacker ? kInfinity : 0;
+    uint32_t dn = attacker ? 0 : kInfinity;
+    size_t best = 0;
+    uint32_t second = kInfinity;
+    for (size_t i = 0; i < children.size(); ++i) {
+      entries[i] = Lookup(children[i].key);
+      // The number of the child to work on: its proof number at the
+      // attacker, its disproof number at the defender.
+      const uint32_t value = attacker ? entries[i].pn : entries[i].dn;
+      const uint32_t best_value =
+          attacker ? entries[best].pn : entries[best].dn;
+      if (i == 0 || value < best_value) {
+        if (i != 0) second = best_value;
+        best = i;
+      } else if (value < second) {
+        second = value;
+      }
+      if (attacker) {
+        pn = std::min(pn, entries[i].pn);
+        dn = Add(dn, entries[i].dn);
+      } else {
+        pn = Add(pn, entries[i].pn);
+        dn = std::min(dn, entries[i].dn);
+      }
+    }
+    entry.pn = pn;
+    entry.dn = dn;
+    if (pn == 0) {
+      // Shortest mate at the attacker, longest at the defender.
+      int plies = attacker ? 0xFFFF : 0;
+      for (const Entry& child : entries) {
+        if (child.pn != 0) continue;
+        plies = attacker ? std::min<int>(plies, child.plies)
+                         : std::max<int>(plies, child.plies);
+      }
+      entry.plies = static_cast<uint16_t>(plies + 1);
+    }
+    if (pn >= pn_threshold || dn >= dn_threshold || aborted_) break;
+
+    const Entry& child = entries[best];
+    uint32_t child_pn_threshold;
+    uint32_t child_dn_threshold;
+    if (attacker) {
+      child_pn_threshold = std::min(pn_threshold, Add(second, 1));
+      child_dn_threshold = std::min<uint64_t>(
+          kInfinity, uint64_t{dn_threshold} - dn + child.dn);
+    } else {
+      child_pn_threshold = std::min<uint64_t>(
+          kInfinity, uint64_t{pn_threshold} - pn + child.pn);
+      child_dn_threshold = std::min(dn_threshold, Add(second, 1));
+    }
+    Mid(children[best].board, depth - 1, child_pn_threshold,
+        child_dn_threshold);
+  }
+  entry.work = static_cast<uint32_t>(
+      std::min<uint64_t>(nodes_ - start + 1, 0xFFFFFFFF));
+  Store(entry);
+}
+
+MateResult MateSolver::Solve(const ChessBoard& board, int moves,
+                             uint64_t max_nodes) {
+  // The table is kept: proofs and disproofs stay true, and the other
+  // numbers are only estimates anyway.
+  nodes_ = 0;
+  max_nodes_ = max_nodes;
+  aborted_ = false;
+  const int depth = 2 * moves - 1;
+  MateResult result;
+  if (depth <= 0) {
+    result.status = MateStatus::kNoMate;
+    return result;
+  }
+  Mid(board, depth, kInfinity, kInfinity);
+  result.nodes = nodes_;
+  const Entry root = Lookup(Key(board, depth));
+  if (root.pn != 0) {
+    result.status = root.dn == 0 ? MateStatus::kNoMate : MateStatus::kUnknown;
+    return result;
+  }
+  result.status = MateStatus::kMate;
+
+  // Follow the proof. Parts of it may have been overwritten since, those are
+  // proven again, without a node limit as they were proven before.
+  max_nodes_ = 0;
+  aborted_ = false;
+  ChessBoard position = board;
+  bool retried = false;
+  for (int left = depth; left > 0;) {
+    const bool attacker = left % 2 == 1;
+    const std::vector<Child> children = Children(position, left);
+    if (children.empty()) break;
+    const Child* next = nullptr;
+    int next_plies = 0;
+    for (const Child& child : children) {
+      const Entry entry = Lookup(child.key);
+      if (entry.pn != 0) continue;
+      if (!next || (attacker ? entry.plies < next_plies
+                             : entry.plies > next_plies)) {
+        next = &child;
+        next_plies = entry.plies;
+      }
+    }
+    // At the defender every child has to be proven to pick the longest.
+    const bool complete =
+        attacker ? next != nullptr
+                 : std::all_of(children.begin(), children.end(),
+                               [this](const Child& child) {
+                                 return Lookup(child.key).pn == 0;
+                               });
+    if (!complete) {
+      if (retried) break;
+      Mid(position, left, kInfinity, kInfinity);
+      retried = true;
+      continue;
+    }
+    retried = false;
+    result.line.push_back(next->move);
+    position = next->board;
+    --left;
+  }
+  result.nodes = nodes_;
+  return result;
+}
+
+}  // namespace lczero
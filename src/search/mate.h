@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "chess/board.h"
+
+namespace lczero {
+
+enum class MateStatus { kMate, kNoMate, kUnknown };
+
+struct MateResult {
+  MateStatus status = MateStatus::kUnknown;
+  // With kMate, the moves of both sides up to the mate, each from the view
+  // of the side making it (as ChessBoard has them). The defender picks the
+  // replies which take longest.
+  std::vector<Move> line;
+  uint64_t nodes = 0;
+};
+
+// Depth-first proof-number search (df-pn) for mates by a series of checks:
+// the attacker only plays the legal moves which give check, the defender
+// answers with GenerateEvasions(). That keeps the tree narrow, so long
+// forced mates through jumps are found much faster than by Search.
+//
+// kNoMate only means there is no such mate within the given number of
+// moves; mates with quiet moves are not looked for. The mate found is not
+// necessarily the shortest one. Repetitions and the fifty move rule are
+// ignored. Proof and disproof numbers are kept in a table of our own, keyed
+// by position and remaining plies, which is kept from one Solve() to the
+// next. One MateSolver per thread.
+class MateSolver {
+ public:
+  explicit MateSolver(size_t megabytes);
+
+  // Looks for a mate in at most @moves moves by the side to move in @board,
+  // giving up after @max_nodes expanded nodes (0 for no limit).
+  MateResult Solve(const ChessBoard& board, int moves, uint64_t max_nodes);
+
+ private:
+  struct Entry {
+    uint64_t key = 0;
+    uint32_t pn = 1;
+    uint32_t dn = 1;
+    // Nodes expanded below the position, entries with less are replaced
+    // first.
+    uint32_t work = 0;
+    // For proven positions, plies to the mate.
+    uint16_t plies = 0;
+  };
+
+  struct Child {
+    Move move;
+    ChessBoard board;
+    uint64_t key;
+  };
+
+  // Children of @board with @depth plies left; the attacker moves when
+  // @depth is odd.
+  std::vector<Child> Children(const ChessBoard& board, int depth) const;
+  // Searches @board until its proof number reaches @pn_threshold or its
+  // disproof number reaches @dn_threshold, and stores the result.
+  void Mid(const ChessBoard& board, int depth, uint32_t pn_threshold,
+           uint32_t dn_threshold);
+  Entry Lookup(uint64_t key) const;
+  void Store(const Entry& entry);
+
+  // Two entries per bucket.
+  std::vector<Entry> table_;
+  uint64_t mask_;
+  uint64_t nodes_ = 0;
+  uint64_t max_nodes_ = 0;
+  bool aborted_ = false;
+};
+
+}  // namespace lczero
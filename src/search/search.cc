@@ -0,0 +1,222 @@
+#include "search/search.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace lczero {
+
+namespace {
+
+const int kMaxPly = 64;
+
+bool IsCapture(const ChessBoard& board, Move move) {
+  if (board.theirs().get(move.to())) return true;
+  // En passant: a plain pawn capture from rank 5 onto the flagged file, as in
+  // ChessBoard::ApplyMove(). Jumped pawns can't take en passant.
+  return board.pawns().get(move.from()) && move.from().row() == 4 && move.to().row() == 5 &&
+         std::abs(move.from().col() - move.to().col()) == 1 &&
+         board.en_passant().get(7, move.to().col());
+}
+
+bool IsPromotion(const ChessBoard& board, Move move) {
+  return move.to().row() == 7 && !board.our_king().get(move.from());
+}
+
+// Legal moves with sort keys: the hash move first, then captures and
+// promotions by exchange value, then quiet moves. With @tactical_only only
+// captures and promotions are generated.
+std::vector<std::pair<int, Move>> OrderedMoves(const ChessBoard& board,
+                                               Move hash_move,
+                                               bool tactical_only) {
+  MoveList moves;
+  if (tactical_only) {
+    moves = board.GenerateCaptures();
+    const MoveList promotions = board.GeneratePromotions();
+    moves.insert(moves.end(), promotions.begin(), promotions.end());
+  } else {
+    moves = board.GenerateLegalMoves();
+    RemoveDuplicateMoves(&moves);
+  }
+  std::vector<std::pair<int, Move>> result;
+  result.reserve(moves.size());
+  for (Move move : moves) {
+    const bool tactical =
+        tactical_only || IsCapture(board, move) || IsPromotion(board, move);
+    int key;
+    if (move == hash_move) {
+      key = 1 << 20;
+    } else if (tactical) {
+      key = (1 << 16) + board.StaticExchange(move);
+    } else {
+      key = 0;
+    }
+    result.emplace_back(key, move);
+  }
+  std::stable_sort(
+      result.begin(), result.end(),
+      [](const std::pair<int, Move>& a, const std::pair<int, Move>& b) {
+        return a.first > b.first;
+      });
+  return result;
+}
+
+// Mate scores are stored relative to the node, not the root.
+int ToTT(int score, int ply) {
+  if (score > kMateBound) return score + ply;
+  if (score < -kMateBound) return score - ply;
+  return score;
+}
+
+int FromTT(int score, int ply) {
+  if (score > kMateBound) return score - ply;
+  if (score < -kMateBound) return score + ply;
+  return score;
+}
+
+}  // namespace
+
+Search::Search(TranspositionTable* tt, const EvalParams& eval,
+               const nnue::Network* network)
+    : tt_(tt), eval_(eval), network_(network) {
+  // Quiescence evaluates at most at kMaxPly.
+  if (network_) accumulators_.resize(kMaxPly + 1);
+}
+
+ChessBoard Search::Child(const ChessBoard& board, Move move, int ply) {
+  ChessBoard child(board);
+  child.ApplyMove(move);
+  if (network_) {
+    network_->Update(board, child, accumulators_[ply], &accumulators_[ply + 1]);
+    accumulators_[ply + 1].Mirror();
+  }
+  child.Mirror();
+  return child;
+}
+
+int Search::Eval(const ChessBoard& board, int ply) {
+  if (network_) return network_->Evaluate(accumulators_[ply]);
+  return Evaluate(board, eval_, &eval_cache_);
+}
+
+bool Search::CountNode() {
+  ++nodes_;
+  if (abort_nodes_ && nodes_ >= abort_nodes_) aborted_ = true;
+  // Reading the clock at every node would cost more than the node.
+  if ((nodes_ & 1023) == 0 &&
+      deadline_ != std::chrono::steady_clock::time_point::max() &&
+      std::chrono::steady_clock::now() >= deadline_) {
+    aborted_ = true;
+  }
+  return aborted_;
+}
+
+SearchResult Search::Run(
+    const ChessBoard& board, const SearchLimits& limits,
+    const std::function<void(const SearchResult&)>& info) {
+  nodes_ = 0;
+  if (network_) network_->Refresh(board, &accumulators_[0]);
+  aborted_ = false;
+  abort_nodes_ = limits.nodes ? 2 * limits.nodes : 0;
+  deadline_ = limits.deadline;
+  if (tt_) tt_->NewSearch();
+  SearchResult result;
+  for (int depth = 1; depth <= limits.depth; ++depth) {
+    Move best;
+    const int score =
+        AlphaBeta(board, depth, 0, -kMateScore - 1, kMateScore + 1, &best);
+    if (aborted_) break;
+    result.best_move = best;
+    result.score = score;
+    result.depth = depth;
+    if (info) {
+      result.nodes = nodes_;
+      info(result);
+    }
+    if (limits.nodes && nodes_ >= limits.nodes) break;
+  }
+  if (!result.best_move) {
+    // Aborted during the first iteration, any legal move will do.
+    MoveList moves = board.GenerateLegalMoves();
+    if (!moves.empty()) result.best_move = moves.front();
+  }
+  result.nodes = nodes_;
+  return result;
+}
+
+int Search::AlphaBeta(const ChessBoard& board, int depth, int ply, int alpha,
+                      int beta, Move* best) {
+  if (depth <= 0 || ply >= kMaxPly) return Quiescence(board, ply, alpha, beta);
+  if (CountNode()) return 0;
+
+  TTEntry entry;
+  Move hash_move;
+  if (tt_ && tt_->Probe(board, &entry)) {
+    hash_move = entry.move;
+    const int score = FromTT(entry.score, ply);
+    if (ply > 0 && entry.depth >= depth &&
+        (entry.bound == Bound::kExact ||
+         (entry.bound == Bound::kLower && score >= beta) ||
+         (entry.bound == Bound::kUpper && score <= alpha))) {
+      if (best) *best = entry.move;
+      return score;
+    }
+  }
+
+  const auto moves = OrderedMoves(board, hash_move, false);
+  if (moves.empty()) return board.IsUnderCheck() ? -kMateScore + ply : 0;
+
+  const int original_alpha = alpha;
+  int best_score = -kMateScore - 1;
+  Move best_move;
+  for (const auto& item : moves) {
+    const ChessBoard child = Child(board, item.second, ply);
+    const int score =
+        -AlphaBeta(child, depth - 1, ply + 1, -beta, -alpha, nullptr);
+    if (aborted_) return 0;
+    if (score > best_score) {
+      best_score = score;
+      best_move = item.second;
+    }
+    if (score > alpha) alpha = score;
+    if (alpha >= beta) break;
+  }
+
+  if (tt_) {
+    TTEntry store;
+    store.move = best_move;
+    store.score = static_cast<int16_t>(ToTT(best_score, ply));
+    store.depth = static_cast<int8_t>(depth);
+    store.bound = best_score >= beta ? Bound::kLower
+                  : best_score > original_alpha ? Bound::kExact
+                                                : Bound::kUpper;
+    tt_->Store(board, store);
+  }
+  if (best) *best = best_move;
+  return best_score;
+}
+
+int Search::Quiescence(const ChessBoard& board, int ply, int alpha, int beta) {
+  if (CountNode()) return 0;
+
+  // Standing pat in a mate or stalemate would be wrong.
+  if (!board.HasAnyLegalMove()) return board.IsUnderCheck() ? -kMateScore + ply : 0;
+  const int stand_pat = Eval(board, ply);
+  if (stand_pat >= beta || ply >= kMaxPly) return stand_pat;
+  if (stand_pat > alpha) alpha = stand_pat;
+
+  for (const auto& item : OrderedMoves(board, Move(), true)) {
+    // Losing captures are not worth looking at. Keys are sorted, so all the
+    // rest lose as well.
+    if (item.first < (1 << 16)) break;
+    const ChessBoard child = Child(board, item.second, ply);
+    const int score = -Quiescence(child, ply + 1, -beta, -alpha);
+    if (aborted_) return 0;
+    if (score >= beta) return score;
+    if (score > alpha) alpha = score;
+  }
+  return alpha;
+}
+
+}  // namespace lczero
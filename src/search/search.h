@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "chess/board.h"
+#include "neural/nnue.h"
+#include "search/evaluation.h"
+#include "search/transposition.h"
+
+namespace lczero {
+
+const int kMateScore = 30000;
+// Scores beyond this are mates, kMateScore - ply.
+const int kMateBound = kMateScore - 1000;
+
+struct SearchLimits {
+  // Iterative deepening stops after this depth.
+  int depth = 4;
+  // Stops at the first iteration boundary after this many nodes, 0 for no
+  // limit. The search also aborts mid-iteration at twice the limit.
+  uint64_t nodes = 0;
+  // Aborts mid-iteration once this passes, with the result of the last
+  // finished iteration.
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+};
+
+struct SearchResult {
+  Move best_move;
+  int score = 0;
+  int depth = 0;
+  uint64_t nodes = 0;
+};
+
+// Alpha-beta search with iterative deepening and a capture quiescence
+// search. Captures are ordered by StaticExchange() and the quiescence search
+// skips the losing ones. One Search per thread; the transposition table and
+// the network may be shared.
+class Search {
+ public:
+  // Positions are evaluated with @network if there is one, with Evaluate()
+  // and @eval otherwise.
+  Search(TranspositionTable* tt, const EvalParams& eval,
+         const nnue::Network* network = nullptr);
+
+  // @info, if set, gets the result of every finished iteration.
+  SearchResult Run(
+      const ChessBoard& board, const SearchLimits& limits,
+      const std::function<void(const SearchResult&)>& info = nullptr);
+
+ private:
+  int AlphaBeta(const ChessBoard& board, int depth, int ply, int alpha,
+                int beta, Move* best);
+  int Quiescence(const ChessBoard& board, int ply, int alpha, int beta);
+  // @board after @move, with the accumulator of @ply + 1 updated to match.
+  ChessBoard Child(const ChessBoard& board, Move move, int ply);
+  int Eval(const ChessBoard& board, int ply);
+  // Counts a node and tells whether the search has to stop.
+  bool CountNode();
+
+  TranspositionTable* const tt_;
+  const EvalParams eval_;
+  const nnue::Network* const network_;
+  // Accumulators of the current line, indexed by ply. Empty without a
+  // network.
+  std::vector<nnue::Accumulator> accumulators_;
+  EvalCache eval_cache_;
+  uint64_t nodes_ = 0;
+  uint64_t abort_nodes_ = 0;
+  std::chrono::steady_clock::time_point deadline_;
+  bool aborted_ = false;
+};
+
+}  // namespace lczero
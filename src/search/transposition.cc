@@ -0,0 +1,90 @@
+#include "search/transposition.h"
+
+namespace lczero {
+
+namespace {
+
+uint64_t PackEntry(const TTEntry& entry, uint8_t generation) {
+  const uint64_t move =
+      entry.move.as_packed_int() | (entry.move.castling() ? 1 << 12 : 0);
+  return move | static_cast<uint64_t>(static_cast<uint16_t>(entry.score)) << 16 |
+         static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 32 |
+         static_cast<uint64_t>(entry.bound) << 40 |
+         static_cast<uint64_t>(generation) << 42;
+}
+
+TTEntry UnpackEntry(uint64_t data) {
+  TTEntry entry;
+  entry.move = Move(BoardSquare(static_cast<uint8_t>((data >> 6) & 63)),
+                    BoardSquare(static_cast<uint8_t>(data & 63)));
+  if (data & (1 << 12)) entry.move.SetCastling();
+  entry.score = static_cast<int16_t>(data >> 16);
+  entry.depth = static_cast<int8_t>(data >> 32);
+  entry.bound = static_cast<Bound>((data >> 40) & 3);
+  return entry;
+}
+
+uint8_t Generation(uint64_t data) { return (data >> 42) & 0x3F; }
+int8_t Depth(uint64_t data) { return static_cast<int8_t>(data >> 32); }
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+  size_t size = 1;
+  while (size * 2 * sizeof(Slot) <= megabytes * 1024 * 1024) size *= 2;
+  slots_.reset(new Slot[size]);
+  mask_ = size - 1;
+  Clear();
+}
+
+void TranspositionTable::Clear() {
+  for (uint64_t i = 0; i <= mask_; ++i) {
+    slots_[i].key.store(0, std::memory_order_relaxed);
+    slots_[i].data.store(0, std::memory_order_relaxed);
+  }
+  generation_.store(0, std::memory_order_relaxed);
+}
+
+bool TranspositionTable::Probe(const ChessBoard& board, TTEntry* entry) const {
+  bool flip;
+  const uint64_t hash = board.CanonicalHash(&flip);
+  const Slot& slot = slots_[hash & mask_];
+  const uint64_t key = slot.key.load(std::memory_order_relaxed);
+  const uint64_t data = slot.data.load(std::memory_order_relaxed);
+  if ((key ^ data) != hash || data == 0) return false;
+  *entry = UnpackEntry(data);
+  if (flip) entry->move.FlipHorizontal();
+  return true;
+}
+
+void TranspositionTable::Store(const ChessBoard& board, const TTEntry& entry) {
+  bool flip;
+  const uint64_t hash = board.CanonicalHash(&flip);
+  Slot& slot = slots_[hash & mask_];
+  const uint64_t old_key = slot.key.load(std::memory_order_relaxed);
+  const uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+  const uint8_t generation = generation_.load(std::memory_order_relaxed);
+  // Keep deeper results of the current search for other positions.
+  if ((old_key ^ old_data) != hash && Generation(old_data) == generation &&
+      Depth(old_data) > entry.depth) {
+    return;
+  }
+  TTEntry stored = entry;
+  if (flip) stored.move.FlipHorizontal();
+  const uint64_t data = PackEntry(stored, generation);
+  slot.key.store(hash ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::Hashfull() const {
+  const uint64_t sample = mask_ < 999 ? mask_ + 1 : 1000;
+  const uint8_t generation = generation_.load(std::memory_order_relaxed);
+  int used = 0;
+  for (uint64_t i = 0; i < sample; ++i) {
+    const uint64_t data = slots_[i].data.load(std::memory_order_relaxed);
+    if (data != 0 && Generation(data) == generation) ++used;
+  }
+  return static_cast<int>(used * 1000 / sample);
+}
+
+}  // namespace lczero
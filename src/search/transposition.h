@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "chess/board.h"
+
+namespace lczero {
+
+enum class Bound : uint8_t { kNone, kUpper, kLower, kExact };
+
+struct TTEntry {
+  Move move;
+  int16_t score = 0;
+  int8_t depth = 0;
+  Bound bound = Bound::kNone;
+};
+
+// Transposition table keyed by ChessBoard::CanonicalHash(), so positions
+// which only differ by a left-right flip share an entry. Moves are stored in
+// the canonical orientation and flipped back on probe.
+// Entries are written without locks (the key is stored xor-ed with the data,
+// torn writes are rejected on probe), so the table can be shared by threads.
+class TranspositionTable {
+ public:
+  explicit TranspositionTable(size_t megabytes);
+
+  bool Probe(const ChessBoard& board, TTEntry* entry) const;
+  void Store(const ChessBoard& board, const TTEntry& entry);
+
+  // Marks older entries as replaceable. Call before every new search. With
+  // searches on several threads at once, each of them ages the others'
+  // entries too.
+  void NewSearch() {
+    generation_.store((generation_.load(std::memory_order_relaxed) + 1) & 0x3F,
+                      std::memory_order_relaxed);
+  }
+  void Clear();
+
+  // Per mille of entries used by the current search.
+  int Hashfull() const;
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> data;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  uint64_t mask_;
+  std::atomic<uint8_t> generation_{0};
+};
+
+}  // namespace lczero
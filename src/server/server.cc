@@ -0,0 +1,245 @@
+#include "server/server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Longer lines aren't requests, their connection is dropped.
+const size_t kMaxLineLength = 1 << 16;
+
+std::string MoveString(const ChessBoard& board, Move move) {
+  if (!move) return "none";
+  if (board.flipped()) move.Mirror();
+  return move.as_string();
+}
+
+std::string ResultString(const char* kind, const std::string& id,
+                         const ChessBoard& board, const SearchResult& result) {
+  std::ostringstream line;
+  line << kind << " id=" << id << " depth=" << result.depth
+       << " score=" << result.score << " nodes=" << result.nodes
+       << " move=" << MoveString(board, result.best_move);
+  return line.str();
+}
+
+}  // namespace
+
+struct AnalysisServer::Connection {
+  explicit Connection(int fd) : fd(fd) {}
+  ~Connection() { close(fd); }
+
+  // Writes @line and a newline. Clients which went away are ignored.
+  void Send(const std::string& line) {
+    const std::string data = line + "\n";
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const ssize_t n =
+          send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return;
+      sent += n;
+    }
+  }
+
+  const int fd;
+  std::mutex mutex;
+};
+
+struct AnalysisServer::Request {
+  std::shared_ptr<Connection> connection;
+  std::string id;
+  ChessBoard board;
+  SearchLimits limits;
+};
+
+AnalysisServer::AnalysisServer(const ServerOptions& options)
+    : options_(options), tt_(options.hash_mb) {
+  if (!options_.network.empty()) {
+    network_.reset(new nnue::Network(options_.network));
+  }
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (options_.socket_path.empty() ||
+      options_.socket_path.size() >= sizeof(address.sun_path)) {
+    throw Exception("Bad socket path: " + options_.socket_path);
+  }
+  std::strcpy(address.sun_path, options_.socket_path.c_str());
+  unlink(address.sun_path);
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    const std::string error = std::strerror(errno);
+    if (listen_fd_ >= 0) close(listen_fd_);
+    throw Exception("Can't listen on " + options_.socket_path + ": " + error);
+  }
+}
+
+AnalysisServer::~AnalysisServer() {
+  close(listen_fd_);
+  unlink(options_.socket_path.c_str());
+}
+
+void AnalysisServer::Stop() {
+  stop_ = true;
+  // Wakes up accept() in Run().
+  shutdown(listen_fd_, SHUT_RDWR);
+}
+
+void AnalysisServer::Run() {
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::max(1, options_.threads); ++i) {
+    workers.emplace_back(&AnalysisServer::Worker, this);
+  }
+  while (!stop_) {
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+    const auto connection = std::make_shared<Connection>(fd);
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.push_back(connection);
+    ++readers_;
+    std::thread(&AnalysisServer::ReadRequests, this, connection).detach();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  stop_ = true;
+  queue_.clear();
+  queue_changed_.notify_all();
+  // Readers return once their connection is shut down.
+  for (const auto& connection : connections_) {
+    shutdown(connection->fd, SHUT_RDWR);
+  }
+  readers_done_.wait(lock, [this]() { return readers_ == 0; });
+  lock.unlock();
+  for (auto& worker : workers) worker.join();
+}
+
+void AnalysisServer::ReadRequests(std::shared_ptr<Connection> connection) {
+  std::string buffer;
+  char chunk[4096];
+  while (true) {
+    const ssize_t n = recv(connection->fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buffer.append(chunk, n);
+    size_t end;
+    while ((end = buffer.find('\n')) != std::string::npos) {
+      std::string line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (line.empty()) continue;
+      Request request;
+      request.connection = connection;
+      const std::string error = ParseRequest(line, &request);
+      if (!error.empty()) {
+        connection->Send("error id=" + request.id + " " + error);
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) break;
+      queue_.push_back(std::move(request));
+      queue_changed_.notify_one();
+    }
+    if (buffer.size() > kMaxLineLength) break;
+  }
+
+  // Queued requests keep the connection open until they are answered.
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_.erase(
+      std::find(connections_.begin(), connections_.end(), connection));
+  if (--readers_ == 0) readers_done_.notify_all();
+}
+
+std::string AnalysisServer::ParseRequest(const std::string& line,
+                                         Request* request) const {
+  const Clock::time_point start = Clock::now();
+  request->limits.depth = options_.depth;
+  int time_ms = options_.time_ms;
+  std::string fen;
+  std::istringstream input(line);
+  std::string token;
+  while (input >> token) {
+    const auto equals = token.find('=');
+    const std::string key = token.substr(0, equals);
+    const std::string value =
+        equals == std::string::npos ? "" : token.substr(equals + 1);
+    if (key == "fen") {
+      std::string rest;
+      std::getline(input, rest);
+      fen = value + rest;
+      break;
+    }
+    try {
+      if (key == "id") {
+        request->id = value;
+      } else if (key == "depth") {
+        request->limits.depth = std::stoi(value);
+      } else if (key == "nodes") {
+        request->limits.nodes = std::stoull(value);
+      } else if (key == "time") {
+        time_ms = std::stoi(value);
+      } else {
+        return "unknown key " + key;
+      }
+    } catch (const std::exception&) {
+      return "bad value for " + key;
+    }
+  }
+  if (fen.empty()) return "no fen";
+  // SetFromFen() checks the layout (8 ranks of 8 files, one king per side)
+  // before it sets any square, and throws on anything else.
+  try {
+    request->board.SetFromFen(fen);
+  } catch (const Exception& e) {
+    return e.what();
+  }
+  time_ms = std::min(std::max(time_ms, 0), options_.max_time_ms);
+  request->limits.deadline = start + std::chrono::milliseconds(time_ms);
+  return "";
+}
+
+void AnalysisServer::Worker() {
+  Search search(&tt_, options_.eval, network_.get());
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_changed_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) return;
+      request = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    Connection& connection = *request.connection;
+    if (Clock::now() >= request.limits.deadline) {
+      connection.Send("error id=" + request.id + " deadline passed in queue");
+      continue;
+    }
+    const SearchResult result = search.Run(
+        request.board, request.limits,
+        [&request, &connection](const SearchResult& iteration) {
+          connection.Send(
+              ResultString("info", request.id, request.board, iteration));
+        });
+    connection.Send(
+        ResultString("bestmove", request.id, request.board, result));
+  }
+}
+
+}  // namespace lczero
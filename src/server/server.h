@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "neural/nnue.h"
+#include "search/search.h"
+#include "search/transposition.h"
+
+namespace lczero {
+
+struct ServerOptions {
+  // Path of the Unix domain socket. A file already there is replaced.
+  std::string socket_path;
+  // Searches running at once.
+  int threads = 1;
+  // Transposition table shared by all threads.
+  size_t hash_mb = 64;
+  EvalParams eval;
+  // Network file (see neural/nnue.h) to evaluate with instead of @eval.
+  std::string network;
+  // Limits of requests which don't give their own.
+  int depth = 8;
+  int time_ms = 1000;
+  // Requests get no more time than this.
+  int max_time_ms = 10000;
+};
+
+// Analysis daemon for many clients at once on a Unix domain socket, so that
+// they don't pay for process startup, table allocation and network loading
+// per position. Clients send one request per line:
+//   [id=<tag>] [depth=<n>] [nodes=<n>] [time=<ms>] fen=<FEN>
+// with fen= last, it takes the rest of the line. The time counts from when
+// the request is read, so waiting in the queue counts too. Replies, with
+// moves from white's side as in Move::as_string():
+//   info id=<tag> depth=<n> score=<cp> nodes=<n> move=<move>
+// after every finished iteration, then
+//   bestmove id=<tag> depth=<n> score=<cp> nodes=<n> move=<move>
+// or move=none when there is no legal move. Bad requests and requests still
+// queued at their deadline get
+//   error id=<tag> <message>
+// Requests of all clients go into one queue served by a pool of searches
+// sharing one transposition table. Requests of one connection may be
+// answered in any order, the id tells them apart.
+class AnalysisServer {
+ public:
+  // Binds the socket and loads the network. Throws Exception if either
+  // fails.
+  explicit AnalysisServer(const ServerOptions& options);
+  ~AnalysisServer();
+
+  // Serves clients until Stop().
+  void Run();
+  // Makes Run() return, dropping queued requests. Only makes async-signal-
+  // safe calls, so signal handlers may call it.
+  void Stop();
+
+ private:
+  struct Connection;
+  struct Request;
+
+  void ReadRequests(std::shared_ptr<Connection> connection);
+  // Parses @line into @request, or returns an error message.
+  std::string ParseRequest(const std::string& line, Request* request) const;
+  void Worker();
+
+  const ServerOptions options_;
+  std::unique_ptr<nnue::Network> network_;
+  TranspositionTable tt_;
+  int listen_fd_ = -1;
+  std::atomic<bool> stop_{false};
+
+  std::mutex mutex_;
+  std::condition_variable queue_changed_;
+  std::deque<Request> queue_;
+  // Open connections, to close them on Stop(), and the number of reader
+  // threads still running.
+  std::vector<std::shared_ptr<Connection>> connections_;
+  int readers_ = 0;
+  std::condition_variable readers_done_;
+};
+
+}  // namespace lczero
@@ -0,0 +1,322 @@
+#include "tablebase/generator.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <utility>
+#include "chess/attacks.h"
+#include "chess/packed_position.h"
+#include "chess/tables.h"
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+
+// Value used for positions not resolved yet.
+const uint8_t kTbUnknown = 255;
+
+bool FileExists(const std::string& filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+// Runs @fn(begin, end) on @threads threads over chunks of [0, size).
+void ParallelFor(uint64_t size, int threads,
+                 const std::function<void(uint64_t, uint64_t)>& fn) {
+  const uint64_t kChunk = 4096;
+  std::atomic<uint64_t> next{0};
+  auto worker = [&]() {
+    while (true) {
+      const uint64_t begin = next.fetch_add(kChunk);
+      if (begin >= size) return;
+      fn(begin, std::min(size, begin + kChunk));
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; ++i) pool.emplace_back(worker);
+  worker();
+  for (auto& thread : pool) thread.join();
+}
+
+// Squares a piece of PackedPosition type @type on @square attacks without
+// jumping.
+BitBoard PlainAttacks(uint8_t type, int square, BitBoard occupied) {
+  const BoardSquare from(static_cast<uint8_t>(square));
+  switch (type) {
+    case PackedPosition::kPackedKing:
+      return tables::kKingAttacks[square];
+    case PackedPosition::kPackedKnight:
+      return tables::kKnightAttacks[square];
+    case PackedPosition::kPackedRook:
+      return RookAttacks(from, occupied);
+    case PackedPosition::kPackedBishop:
+      return BishopAttacks(from, occupied);
+    default:
+      return RookAttacks(from, occupied) + BishopAttacks(from, occupied);
+  }
+}
+
+// Empty squares reachable from @squares by jumps over @occupied ones, in
+// either direction, @squares included.
+uint64_t JumpClosure(uint64_t squares, uint64_t occupied) {
+  uint64_t frontier = squares;
+  while (frontier) {
+    const int square = __builtin_ctzll(frontier);
+    frontier &= frontier - 1;
+    for (int dir = 0; dir < 8; ++dir) {
+      const int over = tables::kJumpOver[square][dir];
+      const int landing = tables::kJumpLanding[square][dir];
+      if (landing < 0 || !(occupied >> over & 1) || occupied >> landing & 1 ||
+          squares >> landing & 1) {
+        continue;
+      }
+      squares |= 1ULL << landing;
+      frontier |= 1ULL << landing;
+    }
+  }
+  return squares;
+}
+
+// Materials @material can turn into after one move: a capture of any piece,
+// or any piece but a queen reaching the last rank.
+std::vector<Material> Successors(const Material& material) {
+  std::vector<Material> result;
+  for (int side = 0; side < 2; ++side) {
+    for (int type = 0; type < Material::kPieceTypes; ++type) {
+      const auto piece = static_cast<Material::PieceType>(type);
+      if (material.count(side, piece) == 0) continue;
+      std::string name = material.name();
+      // Side 0 starts at 1 ('K'), side 1 right after "v" + "K".
+      const size_t side_start = side == 0 ? 1 : name.find('v') + 2;
+      const size_t pos = name.find("QRBN"[type], side_start);
+      result.emplace_back(name.substr(0, pos) + name.substr(pos + 1));
+      if (piece != Material::kQueen) {
+        name[pos] = 'Q';
+        result.emplace_back(name);
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+void TablebaseGenerator::Predecessors(const Material& material, uint64_t index,
+                                      int side_to_move,
+                                      std::vector<uint64_t>* result) const {
+  result->clear();
+  ChessBoard board;
+  DecodePosition(material, index, side_to_move, &board);
+  // The position from the point of view of the side which just moved, as
+  // (square, packed piece) pairs.
+  const PackedPosition packed = PackedPosition::FromBoard(board);
+  std::vector<std::pair<int, uint8_t>> pieces;
+  for (BoardSquare square : packed.occupied()) {
+    const size_t i = pieces.size();
+    const uint8_t piece = packed.pieces[i / 2] >> (4 * (i % 2)) & 15;
+    pieces.emplace_back(square.as_int() ^ 56, piece ^ PackedPosition::kTheirs);
+  }
+  ChessBoard after;
+  BoardFromPieces(pieces, &after);
+
+  for (size_t k = 0; k < pieces.size(); ++k) {
+    const uint8_t piece = pieces[k].second;
+    if (piece & PackedPosition::kTheirs) continue;
+    const int to = pieces[k].first;
+    const uint64_t others = (after.ours().as_int() | after.theirs().as_int()) & ~(1ULL << to);
+    // A move jumps, then makes a plain move (or not). Both can be walked
+    // back from its square, which gives every square it may have come from;
+    // the ones it really can are checked by playing the move.
+    const uint64_t landings =
+        (PlainAttacks(piece, to, others).as_int() & ~others) | 1ULL << to;
+    uint64_t sources = JumpClosure(landings, others) & ~(1ULL << to);
+    while (sources) {
+      const int from = __builtin_ctzll(sources);
+      sources &= sources - 1;
+      std::vector<std::pair<int, uint8_t>> before_pieces = pieces;
+      before_pieces[k].first = from;
+      ChessBoard before;
+      BoardFromPieces(before_pieces, &before);
+      const Move move(BoardSquare(static_cast<uint8_t>(from)),
+                      BoardSquare(static_cast<uint8_t>(to)));
+      if (!before.IsPseudoLegal(move) ||
+          !before.IsLegalMove(move, before.IsUnderCheck())) {
+        continue;
+      }
+      ChessBoard played(before);
+      played.ApplyMove(move);
+      // Promotions change the material and aren't predecessors.
+      if (played != after) continue;
+      uint64_t before_index;
+      int before_side;
+      IndexPosition(material, before, &before_index, &before_side);
+      result->push_back(before_index);
+    }
+  }
+  std::sort(result->begin(), result->end());
+  result->erase(std::unique(result->begin(), result->end()), result->end());
+}
+
+TablebaseGenerator::TablebaseGenerator(const std::string& directory, int threads)
+    : directory_(directory), threads_(std::max(1, threads)) {}
+
+std::string TablebaseGenerator::Filename(const Material& material) const {
+  return directory_ + "/" + material.CanonicalName() + ".sjtb";
+}
+
+void TablebaseGenerator::Generate(const std::string& material) {
+  Require(Material(material));
+}
+
+void TablebaseGenerator::Require(const Material& material) {
+  if (material.kings_only()) return;
+  const std::string name = material.CanonicalName();
+  if (tables_.count(name)) return;
+  const Material canonical(name);
+  if (!FileExists(Filename(canonical))) {
+    for (const Material& successor : Successors(canonical)) {
+      if (successor.CanonicalName() != name) Require(successor);
+    }
+    GenerateTable(canonical);
+  }
+  std::unique_ptr<Tablebase> table(new Tablebase(Filename(canonical)));
+  for (int side = 0; side < 2; ++side) {
+    for (uint64_t i = 0; i < canonical.size(); ++i) {
+      const uint8_t v = table->value(side, i);
+      if (v >= kTbDtmBase) max_dtm_ = std::max(max_dtm_, v - kTbDtmBase);
+    }
+  }
+  tables_[name] = std::move(table);
+}
+
+uint8_t TablebaseGenerator::ConversionValue(const ChessBoard& child) const {
+  Material child_material;
+  Material::FromBoard(child, &child_material);
+  if (child_material.kings_only()) return kTbDraw;
+  const auto it = tables_.find(child_material.CanonicalName());
+  if (it == tables_.end()) throw Exception("Missing table " + child_material.name());
+  uint64_t index;
+  int side_to_move;
+  IndexPosition(it->second->material(), child, &index, &side_to_move);
+  return it->second->value(side_to_move, index);
+}
+
+void TablebaseGenerator::GenerateTable(const Material& material) {
+  const uint64_t size = material.size();
+  // Per position, side 0 to move first: the value, the number of distinct
+  // positions reached by moves which aren't known to lose yet, the ply of a
+  // win by converting and the ply of the loss once nothing else is left.
+  std::unique_ptr<std::atomic<uint8_t>[]> values(new std::atomic<uint8_t>[2 * size]);
+  std::unique_ptr<std::atomic<uint16_t>[]> remaining(new std::atomic<uint16_t>[2 * size]);
+  std::vector<uint8_t> win_at(2 * size, 0);
+  std::vector<uint8_t> loss_at(2 * size, 0);
+
+  // Forward pass over every position: illegal positions, mates, stalemates
+  // and the values of captures and promotions from the finished tables.
+  ParallelFor(2 * size, threads_, [&](uint64_t begin, uint64_t end) {
+    std::vector<uint64_t> children;
+    for (uint64_t i = begin; i < end; ++i) {
+      const int side_to_move = i / size;
+      values[i] = kTbUnknown;
+      remaining[i] = 0;
+      ChessBoard board;
+      if (!DecodePosition(material, i % size, side_to_move, &board)) {
+        values[i] = kTbIllegal;
+        continue;
+      }
+      ChessBoard opponent(board);
+      opponent.Mirror();
+      if (opponent.IsUnderCheck()) {
+        values[i] = kTbIllegal;
+        continue;
+      }
+      MoveList moves = board.GenerateLegalMoves();
+      if (moves.empty()) {
+        values[i] = board.IsUnderCheck() ? kTbDtmBase : kTbDraw;
+        continue;
+      }
+      children.clear();
+      int draws = 0;
+      for (Move move : moves) {
+        ChessBoard child(board);
+        child.ApplyMove(move);
+        child.Mirror();
+        uint64_t index;
+        int child_side;
+        if (IndexPosition(material, child, &index, &child_side)) {
+          children.push_back(index);
+          continue;
+        }
+        const uint8_t v = ConversionValue(child);
+        if (v < kTbDtmBase) {
+          ++draws;
+          continue;
+        }
+        const int dtm = v - kTbDtmBase + 1;
+        if (dtm % 2) {
+          if (win_at[i] == 0 || dtm < win_at[i]) win_at[i] = dtm;
+        } else {
+          loss_at[i] = std::max<int>(loss_at[i], dtm);
+        }
+      }
+      std::sort(children.begin(), children.end());
+      children.erase(std::unique(children.begin(), children.end()), children.end());
+      // A conversion which draws or wins is never counted off, so the
+      // position can't be lost.
+      remaining[i] = children.size() + (draws > 0 || win_at[i] != 0);
+    }
+  });
+
+  // Retrograde passes: in iteration n, the predecessors of losses in n - 1
+  // become wins in n, and the predecessors of wins in n - 1 lose one move;
+  // a position without moves left loses in n, or later if a conversion
+  // takes longer.
+  for (int n = 1; n <= kTbMaxDtm; ++n) {
+    std::atomic<bool> changed{false};
+    ParallelFor(2 * size, threads_, [&](uint64_t begin, uint64_t end) {
+      std::vector<uint64_t> predecessors;
+      for (uint64_t i = begin; i < end; ++i) {
+        if (values[i] != kTbDtmBase + n - 1) continue;
+        const int side_to_move = i / size;
+        const uint64_t offset = side_to_move == 0 ? size : 0;
+        Predecessors(material, i % size, side_to_move, &predecessors);
+        for (uint64_t index : predecessors) {
+          const uint64_t j = offset + index;
+          if (n % 2) {
+            uint8_t unknown = kTbUnknown;
+            if (values[j].compare_exchange_strong(unknown, static_cast<uint8_t>(kTbDtmBase + n))) {
+              changed = true;
+            }
+          } else if (remaining[j].fetch_sub(1) == 1) {
+            loss_at[j] = std::max<int>(loss_at[j], n);
+          }
+        }
+      }
+    });
+    ParallelFor(2 * size, threads_, [&](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; ++i) {
+        if (values[i] != kTbUnknown) continue;
+        if (win_at[i] == n || (remaining[i] == 0 && loss_at[i] == n)) {
+          values[i] = kTbDtmBase + n;
+          changed = true;
+        }
+      }
+    });
+    // Conversions into finished tables may still resolve positions until the
+    // longest mate there is reached.
+    if (!changed && n > max_dtm_ + 1) break;
+  }
+
+  std::vector<uint8_t> tables[2] = {std::vector<uint8_t>(size), std::vector<uint8_t>(size)};
+  for (uint64_t i = 0; i < 2 * size; ++i) {
+    const uint8_t v = values[i];
+    tables[i / size][i % size] = v == kTbUnknown ? kTbDraw : v;
+  }
+  Tablebase::Write(Filename(material), material, tables[0].data(), tables[1].data());
+}
+
+}  // namespace lczero
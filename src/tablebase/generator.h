@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tablebase/tablebase.h"
+
+namespace lczero {
+
+// Generates pawnless sjadam tablebases by retrograde analysis.
+//
+// A forward pass with ChessBoard's move generator finds mates, stalemates
+// and the values of captures and promotions into finished tables, and
+// counts the distinct positions each position can move to. Then iteration n
+// takes back the moves into the positions resolved in n - 1 plies: their
+// predecessors win in n if those lose, or count off one move if they win,
+// and lose in n once no move is left. Unmoves walk the plain move and the
+// jumps of a piece back from its square, which gives a superset of its
+// origins; each one is kept only if ChessBoard plays the move from there.
+class TablebaseGenerator {
+ public:
+  // Tables are written to (and dependencies loaded from) @directory.
+  TablebaseGenerator(const std::string& directory, int threads);
+
+  // Generates the table for @material and the tables of every material it
+  // can convert into by captures and promotions. Existing files are reused.
+  void Generate(const std::string& material);
+
+ private:
+  // Loads or generates table for @material.
+  void Require(const Material& material);
+  void GenerateTable(const Material& material);
+  // Value of @child, which has different material, from the point of view
+  // of its side to move.
+  uint8_t ConversionValue(const ChessBoard& child) const;
+  // Indices of the distinct positions of @material with the other side to
+  // move, from which a legal move that neither captures nor promotes leads
+  // to position @index with @side_to_move to move.
+  void Predecessors(const Material& material, uint64_t index, int side_to_move,
+                    std::vector<uint64_t>* result) const;
+  std::string Filename(const Material& material) const;
+
+  const std::string directory_;
+  const int threads_;
+  // Finished tables, by canonical material name.
+  std::map<std::string, std::unique_ptr<Tablebase>> tables_;
+  // Longest mate in the finished tables.
+  int max_dtm_ = 0;
+};
+
+}  // namespace lczero
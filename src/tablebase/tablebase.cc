@@ -0,0 +1,277 @@
+#include "tablebase/tablebase.h"
+
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "chess/packed_position.h"
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+
+const char kMagic[4] = {'S', 'J', 'T', 'B'};
+const uint32_t kVersion = 2;
+const char kPieceLetters[] = "QRBN";
+const char kFileSuffix[] = ".sjtb";
+
+// Squares are flipped left to right when the king of side 0 is on files e-h.
+// The other symmetries of the board don't keep sjadam positions equivalent:
+// pieces promote on the last rank and the board faces the side to move.
+int FlipSquare(int square, bool flip) { return flip ? square ^ 7 : square; }
+
+int FirstSquare(const BitBoard& board) { return (*board.begin()).as_int(); }
+
+// Squares of one side: king first, then pieces grouped by Material type.
+struct SidePieces {
+  int king;
+  std::vector<std::pair<Material::PieceType, int>> pieces;
+};
+
+SidePieces CollectSide(const ChessBoard& board, bool ours) {
+  SidePieces result;
+  const BitBoard side = ours ? board.ours() : board.theirs();
+  result.king = FirstSquare(ours ? board.our_king() : board.their_king());
+  const BitBoard by_type[Material::kPieceTypes] = {
+      board.queens() * side, board.rooks() * side, board.bishops() * side,
+      ours ? board.our_knights() : board.their_knights()};
+  for (int type = 0; type < Material::kPieceTypes; ++type) {
+    for (BoardSquare square : by_type[type]) {
+      result.pieces.emplace_back(static_cast<Material::PieceType>(type), square.as_int());
+    }
+  }
+  return result;
+}
+
+const uint8_t kPackedTypes[Material::kPieceTypes] = {
+    PackedPosition::kPackedQueen, PackedPosition::kPackedRook,
+    PackedPosition::kPackedBishop, PackedPosition::kPackedKnight};
+
+}  // namespace
+
+Material::Material(const std::string& name) {
+  const auto v = name.find('v');
+  if (v == std::string::npos) throw Exception("Bad material: " + name);
+  const std::string sides[2] = {name.substr(0, v), name.substr(v + 1)};
+  for (int side = 0; side < 2; ++side) {
+    if (sides[side].empty() || sides[side][0] != 'K') {
+      throw Exception("Bad material: " + name);
+    }
+    for (size_t i = 1; i < sides[side].size(); ++i) {
+      const char* letter = std::strchr(kPieceLetters, sides[side][i]);
+      if (!letter || *letter == '\0') throw Exception("Bad material: " + name);
+      ++counts_[side][letter - kPieceLetters];
+    }
+  }
+}
+
+bool Material::FromBoard(const ChessBoard& board, Material* material) {
+  if (!board.pawns().empty() || !board.castlings().no_legal_castle()) return false;
+  for (int side = 0; side < 2; ++side) {
+    const BitBoard pieces = side == 0 ? board.ours() : board.theirs();
+    material->counts_[side][kQueen] = (board.queens() * pieces).count_few();
+    material->counts_[side][kRook] = (board.rooks() * pieces).count_few();
+    material->counts_[side][kBishop] = (board.bishops() * pieces).count_few();
+    material->counts_[side][kKnight] =
+        (side == 0 ? board.our_knights() : board.their_knights()).count_few();
+  }
+  return true;
+}
+
+std::string Material::name() const {
+  std::string result;
+  for (int side = 0; side < 2; ++side) {
+    if (side == 1) result += 'v';
+    result += 'K';
+    for (int type = 0; type < kPieceTypes; ++type) {
+      result.append(counts_[side][type], kPieceLetters[type]);
+    }
+  }
+  return result;
+}
+
+int Material::pieces() const {
+  int result = 0;
+  for (const auto& side : counts_) {
+    for (int count : side) result += count;
+  }
+  return result;
+}
+
+Material Material::Swapped() const {
+  Material result;
+  result.counts_[0] = counts_[1];
+  result.counts_[1] = counts_[0];
+  return result;
+}
+
+std::string Material::CanonicalName() const {
+  // Queens first, so lexicographic comparison of counts gives the stronger side.
+  return counts_[0] >= counts_[1] ? name() : Swapped().name();
+}
+
+uint64_t Material::size() const {
+  uint64_t result = 32 * 64;
+  for (int i = 0; i < pieces(); ++i) result *= 64;
+  return result;
+}
+
+bool IndexPosition(const Material& material, const ChessBoard& board,
+                   uint64_t* index, int* side_to_move) {
+  Material board_material;
+  if (!Material::FromBoard(board, &board_material)) return false;
+  if (board_material == material) {
+    *side_to_move = 0;
+  } else if (board_material.Swapped() == material) {
+    *side_to_move = 1;
+  } else {
+    return false;
+  }
+  // Side 0 of the material.
+  const SidePieces side0 = CollectSide(board, *side_to_move == 0);
+  const SidePieces side1 = CollectSide(board, *side_to_move == 1);
+  const bool flip = side0.king % 8 > 3;
+
+  const int king0 = FlipSquare(side0.king, flip);
+  uint64_t result = king0 / 8 * 4 + king0 % 8;
+  result = result * 64 + FlipSquare(side1.king, flip);
+  for (const SidePieces* side : {&side0, &side1}) {
+    // Pieces of the same type are indexed in ascending order of squares.
+    std::vector<std::pair<Material::PieceType, int>> pieces = side->pieces;
+    for (auto& piece : pieces) piece.second = FlipSquare(piece.second, flip);
+    std::sort(pieces.begin(), pieces.end());
+    for (const auto& piece : pieces) result = result * 64 + piece.second;
+  }
+  *index = result;
+  return true;
+}
+
+bool DecodePosition(const Material& material, uint64_t index,
+                    int side_to_move, ChessBoard* board) {
+  // (square, packed piece) pairs, side 0 pieces first.
+  std::vector<std::pair<int, uint8_t>> pieces;
+  for (int side = 0; side < 2; ++side) {
+    for (int type = 0; type < Material::kPieceTypes; ++type) {
+      for (int i = 0; i < material.count(side, static_cast<Material::PieceType>(type)); ++i) {
+        pieces.emplace_back(0, kPackedTypes[type]);
+        if (side != side_to_move) pieces.back().second |= PackedPosition::kTheirs;
+      }
+    }
+  }
+  for (auto it = pieces.rbegin(); it != pieces.rend(); ++it) {
+    it->first = index % 64;
+    index /= 64;
+  }
+  const int king1 = index % 64;
+  const int king0 = index / 64 / 4 * 8 + index / 64 % 4;
+  pieces.emplace_back(king0, PackedPosition::kPackedKing |
+                                 (side_to_move == 0 ? 0 : PackedPosition::kTheirs));
+  pieces.emplace_back(king1, PackedPosition::kPackedKing |
+                                 (side_to_move == 1 ? 0 : PackedPosition::kTheirs));
+  return BoardFromPieces(std::move(pieces), board);
+}
+
+bool BoardFromPieces(std::vector<std::pair<int, uint8_t>> pieces, ChessBoard* board) {
+  std::sort(pieces.begin(), pieces.end());
+  PackedPosition packed;
+  std::memset(&packed, 0, sizeof(packed));
+  uint64_t occupancy = 0;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    if (i > 0 && pieces[i].first == pieces[i - 1].first) return false;
+    occupancy |= 1ULL << pieces[i].first;
+    packed.pieces[i / 2] |= pieces[i].second << (4 * (i % 2));
+  }
+  packed.occupancy[0] = static_cast<uint32_t>(occupancy);
+  packed.occupancy[1] = static_cast<uint32_t>(occupancy >> 32);
+  *board = packed.ToBoard();
+  return true;
+}
+
+Tablebase::Tablebase(const std::string& filename) : file_(filename) {
+  TablebaseHeader header;
+  if (file_.size() < sizeof(header)) throw Exception("Bad tablebase file: " + filename);
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+    throw Exception("Bad tablebase file: " + filename);
+  }
+  material_ = Material(std::string(header.material, strnlen(header.material, sizeof(header.material))));
+  if (header.size != material_.size() ||
+      file_.size() != sizeof(header) + 2 * header.size) {
+    throw Exception("Bad tablebase file: " + filename);
+  }
+  tables_[0] = reinterpret_cast<const uint8_t*>(file_.data() + sizeof(header));
+  tables_[1] = tables_[0] + header.size;
+}
+
+bool Tablebase::Probe(const ChessBoard& board, Wdl* wdl, int* dtm) const {
+  uint64_t index;
+  int side_to_move;
+  if (!IndexPosition(material_, board, &index, &side_to_move)) return false;
+  const uint8_t v = value(side_to_move, index);
+  if (v == kTbIllegal) return false;
+  if (v == kTbDraw) {
+    *wdl = Wdl::kDraw;
+    *dtm = 0;
+  } else {
+    *dtm = v - kTbDtmBase;
+    *wdl = *dtm % 2 ? Wdl::kWin : Wdl::kLoss;
+  }
+  return true;
+}
+
+void Tablebase::Write(const std::string& filename, const Material& material,
+                      const uint8_t* side0, const uint8_t* side1) {
+  TablebaseHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  const std::string name = material.name();
+  if (name.size() > sizeof(header.material)) throw Exception("Material too large: " + name);
+  std::memcpy(header.material, name.data(), name.size());
+  header.size = material.size();
+
+  const std::string tmp_filename = filename + ".tmp";
+  std::FILE* file = std::fopen(tmp_filename.c_str(), "wb");
+  if (!file) throw Exception("Cannot write tablebase file: " + filename);
+  const bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(side0, 1, header.size, file) == header.size &&
+                  std::fwrite(side1, 1, header.size, file) == header.size;
+  if (std::fclose(file) != 0 || !ok || std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    throw Exception("Cannot write tablebase file: " + filename);
+  }
+}
+
+Tablebases::Tablebases(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (!dir) throw Exception("Cannot open tablebase directory: " + directory);
+  const size_t suffix_len = std::strlen(kFileSuffix);
+  while (const dirent* entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name.size() <= suffix_len ||
+        name.compare(name.size() - suffix_len, suffix_len, kFileSuffix) != 0) {
+      continue;
+    }
+    std::unique_ptr<Tablebase> table(new Tablebase(directory + "/" + name));
+    const std::string material = table->material().CanonicalName();
+    tables_[material] = std::move(table);
+  }
+  closedir(dir);
+}
+
+bool Tablebases::Probe(const ChessBoard& board, Wdl* wdl, int* dtm) const {
+  Material material;
+  if (!Material::FromBoard(board, &material)) return false;
+  if (material.kings_only()) {
+    *wdl = Wdl::kDraw;
+    *dtm = 0;
+    return true;
+  }
+  const auto it = tables_.find(material.CanonicalName());
+  if (it == tables_.end()) return false;
+  return it->second->Probe(board, wdl, dtm);
+}
+
+}  // namespace lczero
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chess/board.h"
+#include "utils/mapped_file.h"
+
+namespace lczero {
+
+enum class Wdl { kLoss = -1, kDraw = 0, kWin = 1 };
+
+// Material of a pawnless endgame, e.g. "KRvKN". Side 0 is the one before 'v'.
+class Material {
+ public:
+  enum PieceType { kQueen, kRook, kBishop, kKnight, kPieceTypes };
+
+  Material() = default;
+  // Throws Exception on anything but "K[QRBN]*vK[QRBN]*".
+  explicit Material(const std::string& name);
+  // Side 0 is the side to move. Returns false if there are pawns on the
+  // board or castling is still possible.
+  static bool FromBoard(const ChessBoard& board, Material* material);
+
+  std::string name() const;
+  int count(int side, PieceType type) const { return counts_[side][type]; }
+  // Number of pieces besides kings.
+  int pieces() const;
+  bool kings_only() const { return pieces() == 0; }
+  Material Swapped() const;
+  // File name of the table, the stronger side first.
+  std::string CanonicalName() const;
+
+  // Number of positions per side to move.
+  uint64_t size() const;
+
+  bool operator==(const Material& other) const { return counts_ == other.counts_; }
+  bool operator!=(const Material& other) const { return counts_ != other.counts_; }
+
+ private:
+  std::array<std::array<uint8_t, kPieceTypes>, 2> counts_{};
+};
+
+// Values stored per position.
+const uint8_t kTbDraw = 0;
+const uint8_t kTbIllegal = 1;
+// kTbDtmBase + n: side to move wins (odd n) or gets mated (even n) in n
+// plies.
+const uint8_t kTbDtmBase = 2;
+const int kTbMaxDtm = 252;
+
+// Perfect index of pawnless positions: the king of side 0 is moved onto
+// files a-d by flipping the board left to right (32 squares), then every
+// piece (king of side 1, pieces of side 0, pieces of side 1) takes 6 bits.
+// Flipping ranks or the diagonal would change the position, as pieces
+// promote on the last rank.
+// Returns false if @board doesn't have @material (in either orientation).
+bool IndexPosition(const Material& material, const ChessBoard& board,
+                   uint64_t* index, int* side_to_move);
+// Builds the position of @index with @side_to_move to move. Returns false if
+// pieces overlap.
+bool DecodePosition(const Material& material, uint64_t index,
+                    int side_to_move, ChessBoard* board);
+// Builds a board without castling or en passant from (square, piece) pairs,
+// pieces as in PackedPosition::pieces. Returns false if pieces overlap.
+bool BoardFromPieces(std::vector<std::pair<int, uint8_t>> pieces, ChessBoard* board);
+
+// File layout: TablebaseHeader, then values for side 0 to move, then values
+// for side 1 to move, one byte per position.
+struct TablebaseHeader {
+  char magic[4];
+  uint32_t version;
+  char material[16];
+  uint64_t size;
+};
+
+// Mapped tablebase file.
+class Tablebase {
+ public:
+  explicit Tablebase(const std::string& filename);
+
+  const Material& material() const { return material_; }
+  // Raw value, see kTb*.
+  uint8_t value(int side_to_move, uint64_t index) const {
+    return tables_[side_to_move][index];
+  }
+  // Returns false if @board has different material.
+  bool Probe(const ChessBoard& board, Wdl* wdl, int* dtm) const;
+
+  static void Write(const std::string& filename, const Material& material,
+                    const uint8_t* side0, const uint8_t* side1);
+
+ private:
+  MappedFile file_;
+  Material material_;
+  const uint8_t* tables_[2];
+};
+
+// All tablebase files (*.sjtb) of a directory.
+class Tablebases {
+ public:
+  explicit Tablebases(const std::string& directory);
+
+  // Looks up position with up to a few pieces. Positions with only kings are
+  // draws. Returns false if there is no table for the position.
+  bool Probe(const ChessBoard& board, Wdl* wdl, int* dtm) const;
+  size_t size() const { return tables_.size(); }
+
+ private:
+  std::map<std::string, std::unique_ptr<Tablebase>> tables_;
+};
+
+}  // namespace lczero
@@ -0,0 +1,96 @@
+#include "training/writer.h"
+
+#include <cstring>
+#include "utils/exception.h"
+
+namespace lczero {
+
+namespace {
+const char kMagic[4] = {'S', 'J', 'T', 'D'};
+const uint32_t kVersion = 1;
+}  // namespace
+
+TrainingDataWriter::TrainingDataWriter(const std::string& filename) {
+  file_ = std::fopen(filename.c_str(), "ab");
+  if (!file_) throw Exception("Cannot open training data file: " + filename);
+  chunk_.reserve(kChunkRecords);
+  std::fseek(file_, 0, SEEK_END);
+  if (std::ftell(file_) == 0) {
+    TrainingFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.record_size = sizeof(TrainingRecord);
+    std::fwrite(&header, sizeof(header), 1, file_);
+  }
+}
+
+TrainingDataWriter::~TrainingDataWriter() {
+  // Positions of an unfinished game have no result and are dropped.
+  Flush();
+  std::fclose(file_);
+}
+
+void TrainingDataWriter::set_deduplicate(bool deduplicate) {
+  deduplicate_ = deduplicate;
+  if (deduplicate_ && seen_.empty()) seen_.resize(kDedupEntries);
+}
+
+void TrainingDataWriter::AddPosition(const ChessBoard& board, Move move) {
+  if (deduplicate_) {
+    const uint64_t hash = board.CanonicalHash();
+    uint64_t& slot = seen_[hash & (kDedupEntries - 1)];
+    if (slot == hash) {
+      ++duplicates_skipped_;
+      return;
+    }
+    slot = hash;
+  }
+  game_.emplace_back();
+  TrainingRecord& record = game_.back();
+  record.position = PackedPosition::FromBoard(board);
+  record.move = move.as_packed_int();
+  record.result = 0;
+  record.reserved = 0;
+}
+
+void TrainingDataWriter::EndGame(int white_result) {
+  for (TrainingRecord& record : game_) {
+    const bool black_to_move = record.position.flags & 1;
+    record.result = static_cast<int8_t>(black_to_move ? -white_result : white_result);
+    chunk_.push_back(record);
+    if (chunk_.size() >= kChunkRecords) WriteChunk();
+  }
+  game_.clear();
+}
+
+void TrainingDataWriter::Flush() {
+  WriteChunk();
+  std::fflush(file_);
+}
+
+void TrainingDataWriter::WriteChunk() {
+  if (chunk_.empty()) return;
+  if (std::fwrite(chunk_.data(), sizeof(TrainingRecord), chunk_.size(), file_) !=
+      chunk_.size()) {
+    throw Exception("Cannot write training data");
+  }
+  records_written_ += chunk_.size();
+  chunk_.clear();
+}
+
+TrainingDataReader::TrainingDataReader(const std::string& filename)
+    : file_(filename) {
+  TrainingFileHeader header;
+  if (file_.size() < sizeof(header)) throw Exception("Bad training data file: " + filename);
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.record_size != sizeof(TrainingRecord)) {
+    throw Exception("Bad training data file: " + filename);
+  }
+  records_ = reinterpret_cast<const TrainingRecord*>(file_.data() + sizeof(header));
+  // A partially written trailing record is ignored.
+  size_ = (file_.size() - sizeof(header)) / sizeof(TrainingRecord);
+}
+
+}  // namespace lczero
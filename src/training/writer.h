@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "chess/packed_position.h"
+#include "utils/mapped_file.h"
+
+namespace lczero {
+
+// One training sample, 32 bytes.
+struct TrainingRecord {
+  PackedPosition position;
+  // Played move, Move::as_packed_int().
+  uint16_t move;
+  // Game result from the point of view of the side to move: 1, 0 or -1.
+  int8_t result;
+  uint8_t reserved;
+};
+
+static_assert(sizeof(TrainingRecord) == 32, "TrainingRecord must be packed");
+
+// File layout: TrainingFileHeader followed by TrainingRecords. Records are
+// fixed width, so the file can be mapped and indexed directly.
+struct TrainingFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+// Appends training records to a file. Positions of a game are kept in memory
+// until the result is known, records are written out in chunks.
+class TrainingDataWriter {
+ public:
+  static constexpr size_t kChunkRecords = 4096;
+  // Hashes remembered for deduplication, 8 bytes each.
+  static constexpr size_t kDedupEntries = 1 << 20;
+
+  // Opens @filename for appending, creating it if needed.
+  explicit TrainingDataWriter(const std::string& filename);
+  ~TrainingDataWriter();
+
+  // Adds position of the current game and the move played in it.
+  void AddPosition(const ChessBoard& board, Move move);
+  // When enabled, positions already written by this writer (up to left-right
+  // symmetry, see ChessBoard::CanonicalHash()) are skipped. Their hashes go
+  // into a table of kDedupEntries slots (8 MB), a new hash overwriting the
+  // one in its slot, so memory stays fixed however long the writer runs and
+  // older duplicates are only caught while their slot isn't reused.
+  void set_deduplicate(bool deduplicate);
+  // Ends the current game. @white_result is 1 (white won), 0 or -1.
+  void EndGame(int white_result);
+  // Writes all finished games to disk.
+  void Flush();
+
+  uint64_t records_written() const { return records_written_; }
+  uint64_t duplicates_skipped() const { return duplicates_skipped_; }
+
+ private:
+  void WriteChunk();
+
+  std::FILE* file_ = nullptr;
+  std::vector<TrainingRecord> game_;
+  std::vector<TrainingRecord> chunk_;
+  uint64_t records_written_ = 0;
+  bool deduplicate_ = false;
+  // Direct-mapped by hash, 0 for empty slots.
+  std::vector<uint64_t> seen_;
+  uint64_t duplicates_skipped_ = 0;
+};
+
+// Zero-copy reader over a mapped training data file.
+class TrainingDataReader {
+ public:
+  explicit TrainingDataReader(const std::string& filename);
+
+  size_t size() const { return size_; }
+  const TrainingRecord& operator[](size_t idx) const { return records_[idx]; }
+  const TrainingRecord* begin() const { return records_; }
+  const TrainingRecord* end() const { return records_ + size_; }
+
+ private:
+  MappedFile file_;
+  const TrainingRecord* records_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace lczero
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lczero {
+
+// Bump allocator which hands out memory from large chunks.
+// Objects allocated from the arena are never freed one by one, the memory is
+// released all at once (one free per chunk) when the arena is destroyed.
+// Only trivially destructible types may be placed in the arena.
+class Arena {
+ public:
+  static constexpr size_t kDefaultChunkSize = 1 << 20;
+
+  explicit Arena(size_t chunk_size = kDefaultChunkSize)
+      : chunk_size_(chunk_size) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Per-thread allocation region. Every search thread owns its own slab, so
+  // allocations only take the arena lock when the current chunk runs out.
+  // A slab must not outlive the arena it was created from.
+  class Slab {
+   public:
+    explicit Slab(Arena* arena) : arena_(arena) {}
+
+    void* Allocate(size_t size, size_t align) {
+      std::uintptr_t cur = reinterpret_cast<std::uintptr_t>(cur_);
+      std::uintptr_t aligned = (cur + align - 1) & ~(align - 1);
+      if (cur_ == nullptr || aligned + size > reinterpret_cast<std::uintptr_t>(end_)) {
+        const size_t needed = size + align;
+        cur_ = arena_->NewChunk(needed, &end_);
+        cur = reinterpret_cast<std::uintptr_t>(cur_);
+        aligned = (cur + align - 1) & ~(align - 1);
+      }
+      cur_ = reinterpret_cast<char*>(aligned + size);
+      return reinterpret_cast<void*>(aligned);
+    }
+
+    // Allocates and default constructs a contiguous array of @count objects.
+    template <typename T>
+    T* NewArray(size_t count) {
+      static_assert(std::is_trivially_destructible<T>::value,
+                    "Arena objects are never destroyed");
+      T* result = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+      for (size_t i = 0; i < count; ++i) new (result + i) T();
+      return result;
+    }
+
+   private:
+    Arena* arena_;
+    char* cur_ = nullptr;
+    char* end_ = nullptr;
+  };
+
+  // Number of chunks currently held by the arena.
+  size_t chunks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunks_.size();
+  }
+
+  // Whether @pointer points into one of the arena's chunks.
+  bool Contains(const void* pointer) const {
+    const char* p = static_cast<const char*>(pointer);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& chunk : chunks_) {
+      if (p >= chunk.first.get() && p < chunk.first.get() + chunk.second) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Total number of bytes reserved by the arena.
+  size_t bytes_reserved() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_reserved_;
+  }
+
+ private:
+  char* NewChunk(size_t min_size, char** end) {
+    const size_t size = min_size > chunk_size_ ? min_size : chunk_size_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+    bytes_reserved_ += size;
+    *end = chunks_.back().first.get() + size;
+    return chunks_.back().first.get();
+  }
+
+  const size_t chunk_size_;
+  mutable std::mutex mutex_;
+  // Chunks and their sizes.
+  std::vector<std::pair<std::unique_ptr<char[]>, size_t>> chunks_;
+  size_t bytes_reserved_ = 0;
+};
+
+}  // namespace lczero
@@ -0,0 +1,25 @@
+#pragma once
+
+// Instruction set selection. Builds for a specific CPU (-march=native,
+// SJADAM_ARCH=x86-64-v3, ...) use whatever the compiler was told to assume.
+// Portable x86 builds also compile faster variants of a few hot functions
+// with SJADAM_TARGET and pick them at run time.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SJADAM_X86_DISPATCH 1
+#define SJADAM_TARGET(isa) __attribute__((target(isa)))
+
+namespace lczero {
+
+inline bool CpuSupportsBmi2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2");
+}
+
+inline bool CpuSupportsAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+}  // namespace lczero
+#endif
@@ -0,0 +1,219 @@
+#include "utils/stats.h"
+
+#ifdef SJADAM_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace lczero {
+namespace stats {
+namespace {
+
+const char* const kCounterNames[kCounterCount] = {
+    "jump_network_calls", "jump_components",  "jump_cache_hits",
+    "jump_cache_misses",  "pseudolegal_calls", "moves_emitted",
+    "duplicate_moves",    "attack_probes",     "legality_checks"};
+
+const char* const kStageNames[kStageCount] = {
+    "jump_network", "sjadam_pass", "plain_pass", "is_under_attack",
+    "is_legal_move"};
+
+struct Totals {
+  uint64_t counters[kCounterCount] = {};
+  uint64_t stage_calls[kStageCount] = {};
+  uint64_t stage_ticks[kStageCount] = {};
+};
+
+// Only the owning thread writes, so relaxed load + store is enough and is
+// as cheap as a plain increment. Readers may see slightly stale values.
+struct ThreadStats {
+  std::atomic<uint64_t> counters[kCounterCount] = {};
+  std::atomic<uint64_t> stage_calls[kStageCount] = {};
+  std::atomic<uint64_t> stage_ticks[kStageCount] = {};
+
+  ThreadStats();
+  ~ThreadStats();
+
+  void AddTo(Totals* totals) const {
+    for (int i = 0; i < kCounterCount; ++i) {
+      totals->counters[i] += counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < kStageCount; ++i) {
+      totals->stage_calls[i] += stage_calls[i].load(std::memory_order_relaxed);
+      totals->stage_ticks[i] += stage_ticks[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  void Clear() {
+    for (auto& x : counters) x.store(0, std::memory_order_relaxed);
+    for (auto& x : stage_calls) x.store(0, std::memory_order_relaxed);
+    for (auto& x : stage_ticks) x.store(0, std::memory_order_relaxed);
+  }
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadStats*> threads;
+  // Sums of threads which already exited.
+  Totals retired;
+  std::string dump_filename;
+  Format dump_format = Format::kJson;
+};
+
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+ThreadStats::ThreadStats() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  AddTo(&registry.retired);
+  registry.threads.erase(
+      std::find(registry.threads.begin(), registry.threads.end(), this));
+}
+
+ThreadStats& Local() {
+  thread_local ThreadStats stats;
+  return stats;
+}
+
+void Increase(std::atomic<uint64_t>* value, uint64_t delta) {
+  value->store(value->load(std::memory_order_relaxed) + delta,
+               std::memory_order_relaxed);
+}
+
+Totals Collect() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  Totals totals = registry.retired;
+  for (const ThreadStats* thread : registry.threads) thread->AddTo(&totals);
+  return totals;
+}
+
+void DumpRegistered() {
+  Registry& registry = GetRegistry();
+  DumpToFile(registry.dump_filename, registry.dump_format);
+}
+
+// Picks up SJADAM_STATS_DUMP when the program starts.
+struct EnvironmentDump {
+  EnvironmentDump() {
+    const char* filename = std::getenv("SJADAM_STATS_DUMP");
+    if (filename == nullptr || *filename == '\0') return;
+    const std::string name(filename);
+    const bool prometheus =
+        name.size() >= 5 && name.compare(name.size() - 5, 5, ".prom") == 0;
+    DumpAtExit(name, prometheus ? Format::kPrometheus : Format::kJson);
+  }
+} environment_dump;
+
+}  // namespace
+
+uint64_t Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void Add(Counter counter, uint64_t value) {
+  Increase(&Local().counters[counter], value);
+}
+
+void AddStage(Stage stage, uint64_t ticks) {
+  ThreadStats& local = Local();
+  Increase(&local.stage_calls[stage], 1);
+  Increase(&local.stage_ticks[stage], ticks);
+}
+
+std::string Dump(Format format) {
+  const Totals totals = Collect();
+  std::ostringstream out;
+  if (format == Format::kJson) {
+    out << "{\"counters\": {";
+    for (int i = 0; i < kCounterCount; ++i) {
+      out << (i ? ", " : "") << '"' << kCounterNames[i]
+          << "\": " << totals.counters[i];
+    }
+    out << "}, \"stages\": {";
+    for (int i = 0; i < kStageCount; ++i) {
+      out << (i ? ", " : "") << '"' << kStageNames[i]
+          << "\": {\"calls\": " << totals.stage_calls[i]
+          << ", \"ticks\": " << totals.stage_ticks[i] << '}';
+    }
+    out << "}}\n";
+  } else {
+    out << "# TYPE sjadam_events_total counter\n";
+    for (int i = 0; i < kCounterCount; ++i) {
+      out << "sjadam_events_total{event=\"" << kCounterNames[i] << "\"} "
+          << totals.counters[i] << '\n';
+    }
+    out << "# TYPE sjadam_stage_calls_total counter\n";
+    for (int i = 0; i < kStageCount; ++i) {
+      out << "sjadam_stage_calls_total{stage=\"" << kStageNames[i] << "\"} "
+          << totals.stage_calls[i] << '\n';
+    }
+    out << "# TYPE sjadam_stage_ticks_total counter\n";
+    for (int i = 0; i < kStageCount; ++i) {
+      out << "sjadam_stage_ticks_total{stage=\"" << kStageNames[i] << "\"} "
+          << totals.stage_ticks[i] << '\n';
+    }
+  }
+  return out.str();
+}
+
+void DumpToFile(const std::string& filename, Format format) {
+  const std::string dump = Dump(format);
+  if (filename == "-") {
+    std::fputs(dump.c_str(), stderr);
+    return;
+  }
+  FILE* file = std::fopen(filename.c_str(), "w");
+  if (file == nullptr) return;
+  std::fputs(dump.c_str(), file);
+  std::fclose(file);
+}
+
+void DumpAtExit(const std::string& filename, Format format) {
+  Registry& registry = GetRegistry();
+  bool first;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    first = registry.dump_filename.empty();
+    registry.dump_filename = filename;
+    registry.dump_format = format;
+  }
+  if (first) std::atexit(DumpRegistered);
+}
+
+void Reset() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.retired = Totals();
+  for (ThreadStats* thread : registry.threads) thread->Clear();
+}
+
+}  // namespace stats
+}  // namespace lczero
+
+#endif
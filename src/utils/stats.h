@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Hot path instrumentation. Everything here only exists when the build
+// defines SJADAM_STATS (cmake -DSJADAM_STATS=ON). Otherwise the macros below
+// expand to nothing and no code or data is left in the binary.
+//
+// Counters and stage timers are kept per thread, so updates are plain
+// stores without any synchronization. Dumps sum up all live threads and
+// the threads which already exited.
+//
+// Stages nest: time spent in IsUnderAttack while generating moves is also
+// counted in the move generation stage.
+
+#ifdef SJADAM_STATS
+
+namespace lczero {
+namespace stats {
+
+enum Counter {
+  kJumpNetworkCalls,
+  kJumpComponents,
+  kJumpCacheHits,
+  kJumpCacheMisses,
+  kPseudolegalCalls,
+  kMovesEmitted,
+  kDuplicateMoves,
+  kAttackProbes,
+  kLegalityChecks,
+  kCounterCount
+};
+
+enum Stage {
+  kStageJumpNetwork,
+  kStageSjadamPass,
+  kStagePlainPass,
+  kStageIsUnderAttack,
+  kStageIsLegalMove,
+  kStageCount
+};
+
+enum class Format { kJson, kPrometheus };
+
+// Timestamp counter (rdtsc on x86, nanoseconds elsewhere).
+uint64_t Ticks();
+
+void Add(Counter counter, uint64_t value);
+void AddStage(Stage stage, uint64_t ticks);
+
+// Snapshot of all counters and stages in the given format.
+std::string Dump(Format format);
+// Writes the snapshot to @filename, "-" is stderr.
+void DumpToFile(const std::string& filename, Format format);
+// Dumps to @filename when the program exits. Also enabled by setting the
+// SJADAM_STATS_DUMP environment variable to a file name, the format is
+// Prometheus text when the name ends in ".prom" and JSON otherwise.
+void DumpAtExit(const std::string& filename, Format format);
+// Zeroes all counters and stages.
+void Reset();
+
+class ScopedStage {
+ public:
+  explicit ScopedStage(Stage stage) : stage_(stage), start_(Ticks()) {}
+  ~ScopedStage() { AddStage(stage_, Ticks() - start_); }
+
+ private:
+  const Stage stage_;
+  const uint64_t start_;
+};
+
+}  // namespace stats
+}  // namespace lczero
+
+#define SJADAM_COUNT(counter, value) \
+  ::lczero::stats::Add(::lczero::stats::counter, (value))
+#define SJADAM_STAGE_SCOPE(stage) \
+  ::lczero::stats::ScopedStage stats_scope_##stage(::lczero::stats::stage)
+#define SJADAM_STAGE_BEGIN(stage) \
+  const uint64_t stats_start_##stage = ::lczero::stats::Ticks()
+#define SJADAM_STAGE_END(stage)                  \
+  ::lczero::stats::AddStage(::lczero::stats::stage, \
+                            ::lczero::stats::Ticks() - stats_start_##stage)
+
+#else
+
+#define SJADAM_COUNT(counter, value) static_cast<void>(0)
+#define SJADAM_STAGE_SCOPE(stage) static_cast<void>(0)
+#define SJADAM_STAGE_BEGIN(stage) static_cast<void>(0)
+#define SJADAM_STAGE_END(stage) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,88 @@
+// Regression tests for ChessBoard. Returns non-zero if any check fails.
+
+#include <cstdio>
+#include <string>
+#include "chess/board.h"
+#include "utils/exception.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+bool Contains(const MoveList& moves, const ChessBoard& board, const std::string& move) {
+  const Move wanted(move, board.flipped());
+  for (Move m : moves) {
+    if (m == wanted) return true;
+  }
+  return false;
+}
+
+bool HasMove(const ChessBoard& board, const std::string& move) {
+  return Contains(board.GenerateLegalMoves(), board, move);
+}
+
+// The en passant flag on rank 8 sits on a square their rook occupies; it
+// must not count as a pawn attacking b7, for IsUnderAttack() nor for the
+// attack map king moves are checked against.
+void EnPassantFlagIsNoPawn() {
+  for (const char* ep : {"a6", "-"}) {
+    ChessBoard board;
+    board.SetFromFen(std::string("r3k3/8/2K5/pP6/8/8/8/8 w - ") + ep + " 0 1");
+    EXPECT(!board.IsUnderAttack(BoardSquare("b7")));
+    EXPECT(!board.TheirAttacks().get(BoardSquare("b7")));
+    EXPECT(HasMove(board, "c6b7"));
+  }
+}
+
+// Only a plain pawn capture from rank 5 takes en passant. Other pieces
+// may move to the square quietly.
+void EnPassantOnlyByPlainCapture() {
+  ChessBoard board;
+  board.SetFromFen("4k3/8/8/4Pp2/8/8/8/4K3 w - f6 0 1");
+  EXPECT(Contains(board.GenerateCaptures(), board, "e5f6"));
+
+  // e3 jumps over the knight to e5, but can't take en passant from there.
+  board.SetFromFen("4k3/8/8/5p2/4N3/4P3/8/4K3 w - f6 0 1");
+  EXPECT(!HasMove(board, "e3f6"));
+  EXPECT(!Contains(board.GenerateCaptures(), board, "e3f6"));
+
+  board.SetFromFen("3k4/8/R7/3p4/8/8/8/4K3 w - d6 0 1");
+  EXPECT(Contains(board.GenerateChecks(), board, "a6d6"));
+  EXPECT(!Contains(board.GenerateCaptures(), board, "a6d6"));
+}
+
+// Layouts which would put pieces off the board or leave a side without its
+// king are rejected.
+void BadFenLayoutThrows() {
+  for (const char* fen : {"7k1K/8/8/8/8/8/8/8 w - - 0 1", "k7/8/8/8/8/8/8 w - - 0 1",
+                          "k7/8/8/8/8/8/8/8/7K w - - 0 1", "k6K/9/8/8/8/8/8/8 w - - 0 1",
+                          "k7/8/8/8/8/8/8/8 w - - 0 1"}) {
+    bool thrown = false;
+    try {
+      ChessBoard board;
+      board.SetFromFen(fen);
+    } catch (const Exception&) {
+      thrown = true;
+    }
+    EXPECT(thrown);
+  }
+}
+
+}  // namespace
+
+int main() {
+  EnPassantFlagIsNoPawn();
+  EnPassantOnlyByPlainCapture();
+  BadFenLayoutThrows();
+  return failures == 0 ? 0 : 1;
+}
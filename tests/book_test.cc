@@ -0,0 +1,94 @@
+// Round trip of the opening book through a file. Returns non-zero if any
+// check fails.
+
+#include <unistd.h>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include "book/book.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+// Annotations and variations are skipped, a game with a move in another
+// notation is left out without stopping the import.
+const char kGames[] =
+    "[Event \"castling\"]\n"
+    "1. e2e4 $1 e7e5 (1... c7c5 2. g1f3) 2. g1f3+ g8f6!? {quiet}\n"
+    "3. f1e2 f8e7 4. e1g1 e8g8 1-0\n"
+    "\n"
+    "[Event \"san\"]\n"
+    "1. d4 d5 2. c4 1-0\n"
+    "\n"
+    "[Event \"draw\"]\n"
+    "1. d2d4 d7d5 1/2-1/2\n";
+
+ChessBoard Play(const std::string& moves) {
+  ChessBoard board;
+  board.SetFromFen(ChessBoard::kStartingFen);
+  std::istringstream stream(moves);
+  std::string move;
+  while (stream >> move) {
+    board.ApplyMove(Move(move, board.flipped()));
+    board.Mirror();
+  }
+  return board;
+}
+
+void RoundTrip(const std::string& filename) {
+  OpeningBookBuilder builder;
+  std::istringstream input(kGames);
+  builder.AddGames(input);
+  EXPECT(builder.skipped_games() == 1);
+  // 8 moves of the first game, 2 of the last one.
+  EXPECT(builder.size() == 10);
+  builder.Write(filename);
+
+  const OpeningBook book(filename);
+  EXPECT(book.size() == 10);
+  // The win weighs 2 and the draw 1; d2d4 sorts first.
+  const ChessBoard start = Play("");
+  int e2e4 = 0;
+  int d2d4 = 0;
+  for (uint64_t random = 0; random < 3; ++random) {
+    const Move move = book.Probe(start, random);
+    if (move == Move("e2e4")) ++e2e4;
+    if (move == Move("d2d4")) ++d2d4;
+  }
+  EXPECT(e2e4 == 2);
+  EXPECT(d2d4 == 1);
+  // Nothing of the variation nor of the skipped game.
+  EXPECT(book.Probe(Play("e2e4"), 0) == Move("e7e5", true));
+  EXPECT(book.Probe(Play("d2d4 d7d5"), 0) == Move());
+
+  ChessBoard board = Play("e2e4 e7e5 g1f3 g8f6 f1e2 f8e7");
+  const Move castling = book.Probe(board, 0);
+  EXPECT(castling.castling());
+  EXPECT(castling.from() == BoardSquare("e1"));
+  EXPECT(castling.to() == BoardSquare("g1"));
+  board.ApplyMove(castling);
+  board.Mirror();
+  const Move black_castling = book.Probe(board, 0);
+  EXPECT(black_castling.castling());
+  EXPECT(black_castling.to() == BoardSquare("g8", true));
+}
+
+}  // namespace
+
+int main() {
+  const std::string filename = "/tmp/sjadam_book_test." + std::to_string(getpid());
+  RoundTrip(filename);
+  std::remove(filename.c_str());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+// Tests for the match statistics. Returns non-zero if any check fails.
+
+#include <cstdio>
+#include "match/match.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+MatchStats Stats(int wins, int draws, int losses) {
+  MatchStats stats;
+  stats.wins = wins;
+  stats.draws = draws;
+  stats.losses = losses;
+  return stats;
+}
+
+// Results where only one side scores still decide the test.
+void OneSidedResultsDecide() {
+  const SprtParams sprt;
+  EXPECT(Stats(0, 0, 0).Llr(sprt) == 0.0);
+  EXPECT(Stats(40, 0, 0).Llr(sprt) > sprt.upper_bound());
+  EXPECT(Stats(60, 10, 0).Llr(sprt) > sprt.upper_bound());
+  EXPECT(Stats(0, 10, 60).Llr(sprt) < sprt.lower_bound());
+  const double llr = Stats(3, 0, 0).Llr(sprt);
+  EXPECT(llr > 0.0 && llr < sprt.upper_bound());
+}
+
+// Balanced results stay between the bounds.
+void EvenResultsDontDecide() {
+  const SprtParams sprt;
+  const double llr = Stats(20, 60, 20).Llr(sprt);
+  EXPECT(llr > sprt.lower_bound() && llr < sprt.upper_bound());
+}
+
+}  // namespace
+
+int main() {
+  OneSidedResultsDecide();
+  EvenResultsDontDecide();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+// Tests for the search tree's memory. Returns non-zero if any check fails.
+
+#include <cstdio>
+#include "mcts/node.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+// Expands @node and all its children, the way a search fills the arena.
+void ExpandTwoPlies(Node* node, ChessBoard board, Arena::Slab* slab) {
+  if (!node->is_expanded()) node->Expand(board, slab);
+  for (int i = 0; i < node->num_children(); ++i) {
+    Node* child = node->child(i);
+    if (child->is_expanded()) continue;
+    ChessBoard child_board(board);
+    child_board.ApplyMove(child->move());
+    child_board.Mirror();
+    child->Expand(child_board, slab);
+  }
+}
+
+// The first search expands a long line, later moves follow it while new
+// searches keep allocating. The head then stays a node from the first
+// arena, which must not keep every arena since alive.
+void ReusedLineStaysBounded() {
+  NodeTree tree;
+  const int kPlies = 24;
+  {
+    Arena::Slab slab = tree.MakeSlab();
+    ChessBoard board = tree.HeadPosition();
+    Node* node = tree.GetCurrentHead();
+    for (int ply = 0; ply < kPlies; ++ply) {
+      node->Expand(board, &slab);
+      node = node->child(0);
+      board.ApplyMove(node->move());
+      board.Mirror();
+    }
+  }
+  size_t max_bytes = 0;
+  for (int ply = 0; ply < kPlies; ++ply) {
+    Arena::Slab slab = tree.MakeSlab();
+    ExpandTwoPlies(tree.GetCurrentHead(), tree.HeadPosition(), &slab);
+    const Move move = tree.GetCurrentHead()->child(0)->move();
+    const Node* kept = tree.GetCurrentHead()->child(0);
+    const int kept_children = kept->num_children();
+    tree.MakeMove(move);
+    EXPECT(tree.num_arenas() <= 2);
+    // The subtree survives the move, copied or not.
+    EXPECT(tree.GetCurrentHead()->parent() == nullptr);
+    EXPECT(tree.GetCurrentHead()->num_children() == kept_children);
+    for (int i = 0; i < tree.GetCurrentHead()->num_children(); ++i) {
+      EXPECT(tree.GetCurrentHead()->child(i)->parent() == tree.GetCurrentHead());
+    }
+    if (ply > 2 && tree.bytes_reserved() > max_bytes) max_bytes = tree.bytes_reserved();
+  }
+  // Two searches worth of nodes at most, each within a few chunks.
+  EXPECT(max_bytes <= 8 * Arena::kDefaultChunkSize);
+}
+
+}  // namespace
+
+int main() {
+  ReusedLineStaysBounded();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Tests for MoveToJumpNotation(). Returns non-zero if any check fails.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "chess/board.h"
+#include "chess/notation.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+// The rook jumps over its pawn to a3 and moves on to c3; it can't stop on a
+// landing square.
+void JumpEndsWithChessMove() {
+  ChessBoard board;
+  board.SetFromFen(ChessBoard::kStartingFen);
+  EXPECT(MoveToJumpNotation(board, Move("a1c3")) == "Ra1^a3-c3");
+  EXPECT(MoveToJumpNotation(board, Move("e2e4")) == "e2-e4");
+}
+
+// Every legal move along random games is written with a chess move or as a
+// castling.
+void EveryMoveHasChessMove() {
+  uint64_t random = 12345;
+  for (int game = 0; game < 20; ++game) {
+    ChessBoard board;
+    board.SetFromFen(ChessBoard::kStartingFen);
+    for (int ply = 0; ply < 60; ++ply) {
+      const MoveList moves = board.GenerateLegalMoves();
+      if (moves.empty()) break;
+      for (Move move : moves) {
+        const std::string notation = MoveToJumpNotation(board, move);
+        const bool ok = notation.find('-') != std::string::npos ||
+                        notation.find('x') != std::string::npos;
+        if (!ok) std::fprintf(stderr, "%s\n", notation.c_str());
+        EXPECT(ok);
+      }
+      random = random * 6364136223846793005ull + 1442695040888963407ull;
+      board.ApplyMove(moves[(random >> 33) % moves.size()]);
+      board.Mirror();
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  JumpEndsWithChessMove();
+  EveryMoveHasChessMove();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// Tests for the analysis daemon over a real socket. Returns non-zero if any
+// check fails.
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "server/server.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+class Client {
+ public:
+  explicit Client(const std::string& path) {
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    connected_ = connect(fd_, reinterpret_cast<const sockaddr*>(&address),
+                         sizeof(address)) == 0;
+  }
+  ~Client() { close(fd_); }
+
+  bool connected() const { return connected_; }
+
+  void Send(const std::string& line) {
+    const std::string data = line + "\n";
+    send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+  }
+
+  // Next reply line, empty when the server closed the connection.
+  std::string ReadLine() {
+    std::string line;
+    char c;
+    while (recv(fd_, &c, 1, 0) == 1) {
+      if (c == '\n') return line;
+      line += c;
+    }
+    return line;
+  }
+
+  // Reads replies until the one of kind "bestmove" or "error".
+  std::string ReadResult() {
+    while (true) {
+      const std::string line = ReadLine();
+      if (line.empty() || line.rfind("info ", 0) != 0) return line;
+    }
+  }
+
+ private:
+  int fd_ = -1;
+  bool connected_ = false;
+};
+
+// A rank with too many files used to pass the king check and write off the
+// board.
+void BadFenGetsError(const std::string& path) {
+  Client client(path);
+  EXPECT(client.connected());
+  client.Send("id=bad fen=7k1K/8/8/8/8/8/8/8 w - - 0 1");
+  EXPECT(client.ReadResult().rfind("error id=bad ", 0) == 0);
+  client.Send("id=nokings fen=8/8/8/8/8/8/8/8 w - - 0 1");
+  EXPECT(client.ReadResult().rfind("error id=nokings ", 0) == 0);
+  // The connection still serves good requests.
+  client.Send("id=good depth=1 fen=7k/8/8/8/8/8/8/K7 w - - 0 1");
+  EXPECT(client.ReadResult().rfind("bestmove id=good ", 0) == 0);
+}
+
+}  // namespace
+
+int main() {
+  ServerOptions options;
+  options.socket_path = "/tmp/sjadam_server_test." + std::to_string(getpid());
+  AnalysisServer server(options);
+  std::thread thread([&server]() { server.Run(); });
+  BadFenGetsError(options.socket_path);
+  server.Stop();
+  thread.join();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Generates small tablebases into a temporary directory and checks them
+// against the moves of each position. Returns non-zero if any check fails.
+
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "tablebase/generator.h"
+#include "tablebase/tablebase.h"
+
+using namespace lczero;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                 \
+  do {                                                               \
+    if (!(cond)) {                                                   \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures;                                                    \
+    }                                                                \
+  } while (0)
+
+// Every legal position of @name has the value of the best move: a win in n
+// if some move leads to a loss in n - 1, else a loss in the longest of the
+// wins it can't avoid plus one, else a draw. This includes the moves which
+// capture or promote into the tables the generator loaded.
+void ValuesAreMinimaxOfChildren(const Tablebases& tables, const std::string& name) {
+  const Material material(name);
+  int mismatches = 0;
+  for (int side = 0; side < 2; ++side) {
+    for (uint64_t i = 0; i < material.size(); ++i) {
+      ChessBoard board;
+      if (!DecodePosition(material, i, side, &board)) continue;
+      ChessBoard other(board);
+      other.Mirror();
+      if (other.IsUnderCheck()) continue;
+
+      uint64_t index;
+      int side_to_move;
+      EXPECT(IndexPosition(material, board, &index, &side_to_move));
+      ChessBoard decoded;
+      uint64_t decoded_index;
+      EXPECT(DecodePosition(material, index, side_to_move, &decoded));
+      EXPECT(IndexPosition(material, decoded, &decoded_index, &side_to_move));
+      EXPECT(decoded_index == index);
+
+      Wdl wdl;
+      int dtm;
+      EXPECT(tables.Probe(board, &wdl, &dtm));
+      int shortest_win = kTbMaxDtm + 1;
+      int longest_loss = -1;
+      bool all_lose = true;
+      const MoveList moves = board.GenerateLegalMoves();
+      for (Move move : moves) {
+        ChessBoard child(board);
+        child.ApplyMove(move);
+        child.Mirror();
+        Wdl child_wdl;
+        int child_dtm;
+        EXPECT(tables.Probe(child, &child_wdl, &child_dtm));
+        if (child_wdl == Wdl::kLoss) {
+          shortest_win = std::min(shortest_win, child_dtm + 1);
+          all_lose = false;
+        } else if (child_wdl == Wdl::kDraw) {
+          all_lose = false;
+        } else {
+          longest_loss = std::max(longest_loss, child_dtm + 1);
+        }
+      }
+      Wdl expected_wdl = Wdl::kDraw;
+      int expected_dtm = 0;
+      if (moves.empty()) {
+        if (board.IsUnderCheck()) expected_wdl = Wdl::kLoss;
+      } else if (shortest_win <= kTbMaxDtm) {
+        expected_wdl = Wdl::kWin;
+        expected_dtm = shortest_win;
+      } else if (all_lose) {
+        expected_wdl = Wdl::kLoss;
+        expected_dtm = longest_loss;
+      }
+      if (wdl != expected_wdl || dtm != expected_dtm) ++mismatches;
+    }
+  }
+  if (mismatches) std::fprintf(stderr, "%s: %d mismatches\n", name.c_str(), mismatches);
+  EXPECT(mismatches == 0);
+}
+
+void RemoveDirectory(const std::string& directory) {
+  if (DIR* dir = opendir(directory.c_str())) {
+    while (dirent* entry = readdir(dir)) {
+      const std::string name = entry->d_name;
+      if (name != "." && name != "..") unlink((directory + "/" + name).c_str());
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+}  // namespace
+
+int main() {
+  char directory[] = "/tmp/sjadam_tablebase_test.XXXXXX";
+  if (!mkdtemp(directory)) return 1;
+  // KRvK and KNvK convert by promotion into KQvK, and by captures into KvK.
+  TablebaseGenerator generator(directory, 2);
+  generator.Generate("KRvK");
+  generator.Generate("KNvK");
+  const Tablebases tables(directory);
+  EXPECT(tables.size() == 3);
+  for (const char* name : {"KQvK", "KRvK", "KNvK"}) ValuesAreMinimaxOfChildren(tables, name);
+  RemoveDirectory(directory);
+  return failures == 0 ? 0 : 1;
+}